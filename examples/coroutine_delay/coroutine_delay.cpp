@@ -0,0 +1,68 @@
+#include "app.h"
+
+// include pin naming
+#include "main.h"
+
+// include setup timer handles
+#include "tim.h"
+
+#include "STM32TimerArray.hpp"
+
+// The same setup as in blinky example, with different app_start.
+uint32_t timerInputFrequency = F_CPU;
+uint32_t frequencyDivision = timerInputFrequency/10000;
+uint32_t timerCounterBits = 16;
+TimerArrayControl control(
+    &htim2, // handle for the used timer hardware, setup by CubeMX
+    timerInputFrequency,
+    frequencyDivision,
+    timerCounterBits);
+
+// Storage for the coroutine frames, no heap is used.
+// Room for 2 frames of at most 128 bytes each, a TimerTask is invalid if it does not fit.
+StaticCoroutineArena<128, 2> arena;
+
+// Resumes the coroutines in thread mode, when their delay elapsed.
+TimerExecutor executor;
+
+void led(bool on){
+    HAL_GPIO_WritePin(LD2_GPIO_Port, LD2_Pin, on ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+// The arena must be the first parameter of the coroutine, the frame is allocated from it.
+// Only the allocation uses it, a coroutine that does not pass it on leaves it unnamed.
+TimerTask flash(CoroutineArena&, uint32_t on_ticks){
+    led(true);
+    co_await control.delay(on_ticks, &executor); // the CPU is free while waiting
+    led(false);
+    co_await control.delay(2000, &executor);
+}
+
+TimerTask pattern(CoroutineArena& arena){
+    while(1){
+        // short, short, long flashes, waiting for each to finish
+        co_await control.delay(1000, &executor);
+        flash(arena, 500);
+        co_await control.delay(3000, &executor);
+        flash(arena, 500);
+        co_await control.delay(3000, &executor);
+        flash(arena, 2000);
+        co_await control.delay(5000, &executor);
+    }
+}
+
+void app_start(){
+
+    control.begin();
+
+    // start the sequence, it runs until the first co_await
+    pattern(arena);
+
+    while(1){
+        // resume the sequences whose delay elapsed
+        if (!executor.runPending()){
+            // nothing to do until the next timer interrupt
+            __WFI();
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#include "app.h"
+
+// include pin naming
+#include "main.h"
+
+// include setup timer handles
+#include "tim.h"
+
+#include "STM32TimerArray.hpp"
+
+// 10 kHz tick frequency, same setup as in the blinky example
+TimerArrayControl control(&htim2, F_CPU, F_CPU/10000, 16);
+
+// The LED on channel 2 is toggled by the hardware every half second.
+// The interrupt of a firing only programs the next edge, 10 ticks (1 ms) ahead,
+// this lead has to be longer than the time the interrupt may be delayed by others.
+OutputCompareTimer t_toggle(
+    5000,                         // the number of ticks between the edges
+    true,                         // isPeriodic, repeat the edges
+    TIM_CHANNEL_2,                // channel driving the LED's pin
+    OutputCompareTimer::TOGGLE,   // the hardware changes the pin's level at every edge
+    10                            // lead, ticks between the firing and the edge
+);
+
+void app_start(){
+
+    // Start timer array configured to run at 10 kHz (tick frequency).
+    control.begin();
+
+    // Configure channel 2 for the edges and start the timer, it fires like any other timer.
+    control.attachOutputTimer(&t_toggle);
+
+    // Lay back, the pin is driven by the hardware.
+    while(1);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "TimerArrayControl.hpp"
+
+// Masks every maskable interrupt while in scope, restores the previous state when leaving.
+// Used where data is shared with interrupts of any priority, not only the controller's.
+class CriticalSection{
+public:
+    CriticalSection() : primask(__get_PRIMASK()) {
+        __disable_irq();
+    }
+    ~CriticalSection(){
+        __set_PRIMASK(primask);
+    }
+private:
+    const uint32_t primask;
+};
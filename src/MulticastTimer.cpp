@@ -0,0 +1,101 @@
+#include "MulticastTimer.hpp"
+#include "CriticalSection.hpp"
+
+// -----                                -----
+// ----- TimerSubscriber implementation -----
+// -----                                -----
+
+TimerSubscriber::TimerSubscriber(const Timer::callback_function f)
+    : f(f), prev(nullptr), next(nullptr), timer(nullptr)
+{}
+
+bool TimerSubscriber::isSubscribed() const {
+    return timer != nullptr;
+}
+
+void TimerSubscriber::fire(const TimerFireInfo&){
+    f();
+}
+
+// -----                               -----
+// ----- MulticastTimer implementation -----
+// -----                               -----
+
+MulticastTimer::MulticastTimer(uint32_t delay, bool periodic)
+    : Timer(delay, periodic, nullptr), head(nullptr), cursors(nullptr), count(0)
+{}
+
+void MulticastTimer::subscribe(TimerSubscriber* subscriber){
+    // the list is walked by the controller's interrupt, which can have any priority
+    CriticalSection cs;
+
+    if (subscriber->timer == this) return;
+    if (subscriber->timer) subscriber->timer->unsubscribe(subscriber);
+
+    // insert at the front, an ongoing firing is already past it
+    subscriber->prev = nullptr;
+    subscriber->next = head;
+    if (head) head->prev = subscriber;
+    head = subscriber;
+    subscriber->timer = this;
+    ++count;
+}
+
+void MulticastTimer::unsubscribe(TimerSubscriber* subscriber){
+    CriticalSection cs;
+
+    if (subscriber->timer != this) return;
+
+    // the ongoing firings continue with the next subscriber
+    for (FanOutCursor* it = cursors; it; it = it->outer){
+        if (it->next == subscriber) it->next = subscriber->next;
+    }
+
+    if (subscriber->prev) subscriber->prev->next = subscriber->next;
+    else head = subscriber->next;
+    if (subscriber->next) subscriber->next->prev = subscriber->prev;
+
+    subscriber->prev = nullptr;
+    subscriber->next = nullptr;
+    subscriber->timer = nullptr;
+    --count;
+}
+
+uint16_t MulticastTimer::subscribers() const {
+    return count;
+}
+
+void MulticastTimer::fanOut(const TimerFireInfo& info){
+    FanOutCursor cursor;
+    {
+        CriticalSection cs;
+        cursor.next = head;
+        cursor.outer = cursors;
+        cursors = &cursor;
+    }
+
+    while (true){
+        TimerSubscriber* subscriber;
+        {
+            // advance before the call, the callback or a higher priority interrupt may unsubscribe anyone
+            CriticalSection cs;
+            subscriber = cursor.next;
+            if (!subscriber) break;
+            cursor.next = subscriber->next;
+        }
+        subscriber->fire(info);
+    }
+
+    // nested firings end in reverse order
+    CriticalSection cs;
+    cursors = cursor.outer;
+}
+
+void MulticastTimer::fire(){
+    TimerFireInfo info = {target, target, 0, 0};
+    fanOut(info);
+}
+
+void MulticastTimer::dispatch(const TimerFireInfo& info){
+    fanOut(info);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Timer.hpp"
+
+class MulticastTimer;
+
+// Callback of a MulticastTimer, linked into the timer's subscriber list.
+//
+// f: static function called when the multicast timer is firing
+class TimerSubscriber{
+public:
+    TimerSubscriber(const Timer::callback_function f);
+
+    bool isSubscribed() const;
+
+protected:
+    const Timer::callback_function f;
+    TimerSubscriber* prev;
+    TimerSubscriber* next;
+    MulticastTimer* timer; // the timer subscribed to, nullptr if none
+
+    virtual void fire(const TimerFireInfo& info);
+
+    friend class MulticastTimer;
+};
+
+// Represents a TimerSubscriber with context.
+//
+// ctx: context pointer to an object, will be passed to the callback function
+// ctxf: static function called when the multicast timer is firing, takes a Context* pointer and the timing of the firing
+template<typename Context>
+class ContextTimerSubscriber : public TimerSubscriber{
+public:
+    using dynamic_callback_function = void(*)(Context*, const TimerFireInfo&);
+    ContextTimerSubscriber(Context* ctx, const dynamic_callback_function ctxf) : TimerSubscriber((Timer::callback_function)ctxf), ctx(ctx) {}
+protected:
+    Context* ctx;
+
+    virtual void fire(const TimerFireInfo& info){
+        ((dynamic_callback_function)f)(ctx, info);
+    }
+};
+
+// Timer calling every subscriber on each firing, while taking a single place in the controller's feed.
+// Attach it like any other timer, subscribers can join and leave in O(1) at any time,
+// also from a subscriber's callback. A subscriber joining during a firing is called from the next one.
+// Firings may nest, e.g. manualFire from a subscriber or a higher priority interrupt, each walks the list on its own.
+//
+// delay: ticks of timer array controller until firing
+// periodic: does the timer restart immedietely when fires
+class MulticastTimer : public Timer{
+public:
+    MulticastTimer(uint32_t delay, bool periodic);
+
+    void subscribe(TimerSubscriber* subscriber); // moves the subscriber from its previous timer
+    void unsubscribe(TimerSubscriber* subscriber);
+    uint16_t subscribers() const;
+
+protected:
+    // position of an ongoing firing, on the stack of fanOut
+    struct FanOutCursor{
+        TimerSubscriber* next; // subscriber called next
+        FanOutCursor* outer; // firing interrupted by this one
+    };
+
+    TimerSubscriber* head;
+    FanOutCursor* volatile cursors; // innermost ongoing firing first, unsubscribe moves them past the leaving subscriber
+    uint16_t count;
+
+    void fanOut(const TimerFireInfo& info);
+
+    virtual void fire();
+    virtual void dispatch(const TimerFireInfo& info);
+};
@@ -0,0 +1,28 @@
+#include "OutputCompareTimer.hpp"
+#include "TimerArrayControl.hpp"
+
+// -----                                   -----
+// ----- OutputCompareTimer implementation -----
+// -----                                   -----
+
+OutputCompareTimer::OutputCompareTimer(uint32_t delay, bool isPeriodic, uint32_t channel, Edge edge, uint32_t lead, const callback_function f)
+    : Timer(delay, isPeriodic, f), control(nullptr), _channel(channel), lead(lead), edge(edge), _level(edge == RESET)
+{}
+
+uint32_t OutputCompareTimer::channel() const {
+    return _channel;
+}
+
+bool OutputCompareTimer::level() const {
+    return _level;
+}
+
+void OutputCompareTimer::fire(){
+    if (f) ((callback_function)f)();
+    if (control) control->timerFeed.scheduleEdge(this, control->timerFeed.cnt);
+}
+
+void OutputCompareTimer::dispatch(const TimerFireInfo& info){
+    if (f) ((callback_function)f)();
+    if (control) control->timerFeed.scheduleEdge(this, info.scheduled);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Timer.hpp"
+
+#include <cstdint>
+
+class TimerArrayControl;
+
+// Timer driving the pin of a capture compare channel (2-4) of the controller's hardware timer.
+// The edge is made by the hardware at the exact compare match, the interrupt only programs it:
+// every firing of the timer schedules the next edge lead ticks later, so the edges follow
+// the firing times without the interrupt latency. The lead must be longer than the worst
+// interrupt latency (edges arriving late are forced immedietely) and shorter than the delay.
+// The pin has to be set up for the timer's alternate function, e.g. in CubeMX.
+// Attach it with TimerArrayControl::attachOutputTimer, then handle it as any other timer.
+// Attached by any other method before that, it only calls f and makes no edges.
+// The edges are made on the controller of attachOutputTimer, don't attach it to another one.
+//
+// delay: ticks of timer array controller between firings, the edges come lead ticks after them
+// isPeriodic: does the timer restart immedietely when fires
+// channel: TIM_CHANNEL_2, TIM_CHANNEL_3 or TIM_CHANNEL_4, channel 1 is used by the controller
+// edge: what the hardware does with the pin at the compare match
+// lead: ticks between the firing and the edge
+// f: optional static function called when timer is firing, before the edge
+class OutputCompareTimer : public Timer{
+public:
+    enum Edge : uint8_t { SET, RESET, TOGGLE };
+
+    OutputCompareTimer(uint32_t delay, bool isPeriodic, uint32_t channel, Edge edge, uint32_t lead=1, const callback_function f=nullptr);
+
+    uint32_t channel() const;
+    bool level() const; // pin level after the last scheduled edge
+
+protected:
+    TimerArrayControl* control;
+    const uint32_t _channel;
+    const uint32_t lead;
+    const Edge edge;
+    bool _level;
+
+    virtual void fire(); // edge lead ticks after now, when fired manually
+    virtual void dispatch(const TimerFireInfo& info);
+
+    friend class TimerArrayControl;
+};
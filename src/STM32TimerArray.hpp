@@ -2,3 +2,12 @@
 
 #include "version.h"
 #include "TimerArrayControl.hpp"
+#include "ShardedTimerArray.hpp"
+#include "TwoStageTimer.hpp"
+#include "TimerCapture.hpp"
+#include "MulticastTimer.hpp"
+#include "TimerBlock.hpp"
+
+#if defined(__cpp_impl_coroutine)
+#include "TimerCoroutine.hpp"
+#endif
@@ -0,0 +1,112 @@
+#include "ShardedTimerArray.hpp"
+
+// -----                                  -----
+// ----- ShardedTimerArray implementation -----
+// -----                                  -----
+
+ShardedTimerArray::ShardedTimerArray(TimerArrayControl* const* shards, uint8_t count)
+    : shards(shards), count(count)
+{}
+
+void ShardedTimerArray::begin(){
+    // started back to back, the counters stay close to each other
+    for (uint8_t i = 0; i < count; ++i) shards[i]->begin();
+}
+
+void ShardedTimerArray::stop(){
+    for (uint8_t i = 0; i < count; ++i) shards[i]->stop();
+}
+
+bool ShardedTimerArray::hasCommonTimebase() const{
+    for (uint8_t i = 1; i < count; ++i){
+        // compare fclk/prescaler ratios without rounding
+        if ((uint64_t)shards[i]->fclk() * shards[0]->prescaler() != (uint64_t)shards[0]->fclk() * shards[i]->prescaler()) return false;
+    }
+    return true;
+}
+
+void ShardedTimerArray::attachTimer(Timer* timer){
+    // a cancelled timer is still linked in its shard, it can only be attached there again
+    attachTimer(timer, timer->cancelled ? timer->shard : leastLoadedShard());
+}
+
+void ShardedTimerArray::attachTimer(Timer* timer, uint8_t shard){
+    if (!count || timer->running) return;
+    if (timer->cancelled) shard = timer->shard;
+    if (shard >= count) shard = count - 1;
+
+    timer->shard = shard;
+    shards[shard]->attachTimer(timer);
+}
+
+void ShardedTimerArray::detachTimer(Timer* timer){
+    TimerArrayControl* control = shardOf(timer);
+    if (control) control->detachTimer(timer);
+}
+
+void ShardedTimerArray::cancelTimer(Timer* timer){
+    TimerArrayControl* control = shardOf(timer);
+    if (control) control->cancelTimer(timer);
+}
+
+void ShardedTimerArray::restartTimer(Timer* timer){
+    // a stopped timer is attached again, possibly to another shard
+    if (!timer->running){
+        attachTimer(timer);
+        return;
+    }
+    TimerArrayControl* control = shardOf(timer);
+    if (control) control->restartTimer(timer);
+}
+
+void ShardedTimerArray::changeTimerDelay(Timer* timer, uint32_t delay){
+    TimerArrayControl* control = shardOf(timer);
+    if (control) control->changeTimerDelay(timer, delay);
+    else timer->delay(delay);
+}
+
+void ShardedTimerArray::manualFire(Timer* timer){
+    // a stopped periodic timer is started by the firing, it goes to the least loaded shard
+    if (!timer->running && !timer->cancelled) timer->shard = leastLoadedShard();
+    TimerArrayControl* control = shardOf(timer);
+    if (control) control->manualFire(timer);
+}
+
+uint32_t ShardedTimerArray::remainingTicks(Timer* timer) const{
+    TimerArrayControl* control = shardOf(timer);
+    return control ? control->remainingTicks(timer) : 0;
+}
+
+uint32_t ShardedTimerArray::elapsedTicks(Timer* timer) const{
+    TimerArrayControl* control = shardOf(timer);
+    return control ? control->elapsedTicks(timer) : 0;
+}
+
+uint32_t ShardedTimerArray::ticksUntilNext(){
+    uint32_t ticks = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < count; ++i){
+        uint32_t shardTicks = shards[i]->ticksUntilNext();
+        if (shardTicks < ticks) ticks = shardTicks;
+    }
+    return ticks;
+}
+
+uint8_t ShardedTimerArray::shardCount() const{
+    return count;
+}
+
+uint8_t ShardedTimerArray::leastLoadedShard() const{
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < count; ++i){
+        if (shards[i]->attachedTimers() < shards[best]->attachedTimers()) best = i;
+    }
+    return best;
+}
+
+TimerArrayControl* ShardedTimerArray::shard(uint8_t index) const{
+    return index < count ? shards[index] : nullptr;
+}
+
+TimerArrayControl* ShardedTimerArray::shardOf(const Timer* timer) const{
+    return timer->shard < count ? shards[timer->shard] : nullptr;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "TimerArrayControl.hpp"
+
+#include <cstdint>
+
+// Spreads timers over several controllers, each driving its own hardware timer,
+// so the expiries can be handled on different NVIC priority levels.
+// Shards are indexed by priority class: give shard 0 the highest interrupt priority
+// and isolate high rate timers there from the slow housekeeping timers.
+// Timers are placed on the shard of their class, or on the shard with the least attached timers.
+// Delays mean the same on every shard only if all of them count with the same frequency,
+// check it with hasCommonTimebase.
+//
+// shards: controllers of the shards, the array must outlive the sharded array
+// count: number of shards, at most max_shards
+class ShardedTimerArray{
+public:
+    static const uint8_t max_shards = 255;
+
+    ShardedTimerArray(TimerArrayControl* const* shards, uint8_t count);
+
+    void begin(); // start every shard
+    void stop(); // halt every shard
+    bool hasCommonTimebase() const; // every shard counts with the same frequency
+
+    void attachTimer(Timer* timer); // attach to the least loaded shard
+    void attachTimer(Timer* timer, uint8_t shard); // attach to the shard of a priority class, the last shard takes the classes above it
+    void detachTimer(Timer* timer);
+    void cancelTimer(Timer* timer);
+    void restartTimer(Timer* timer);
+    void changeTimerDelay(Timer* timer, uint32_t delay);
+    void manualFire(Timer* timer);
+
+    uint32_t remainingTicks(Timer* timer) const;
+    uint32_t elapsedTicks(Timer* timer) const;
+    uint32_t ticksUntilNext(); // the soonest of the shards
+
+    uint8_t shardCount() const;
+    uint8_t leastLoadedShard() const;
+    TimerArrayControl* shard(uint8_t index) const;
+    TimerArrayControl* shardOf(const Timer* timer) const; // shard the timer was last attached to
+
+protected:
+    TimerArrayControl* const* const shards;
+    const uint8_t count;
+};
@@ -5,12 +5,18 @@
 // ----- Timer implementation -----
 // -----                      -----
 
+// Node size limits, a larger node means a layout regression.
+// vptr, next and f pointers, 3 counter values, then the periodic flag, the shard index, the priority and the state bits share the rest.
+static_assert(sizeof(TimerLink) == sizeof(Timer*), "the feed root must stay a single pointer");
+static_assert(sizeof(Timer) <= (3*sizeof(void*) + 3*sizeof(timer_ticks_t) + 4 + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*),
+    "Timer node is larger than its packed layout");
+
 Timer::Timer(const callback_function f)
-    : _delay(10), _periodic(false), f((void*)f), running(false), next(nullptr)
+    : f((void*)f), target(0), _delay(10), deadline(0), _periodic(false), shard(0), _priority(0), running(false), cancelled(false), restarted(false), bucketed(false), pending(false), container(false), blocked(false)
 {}
 
 Timer::Timer(uint32_t delay, bool isPeriodic, const callback_function f)
-    : _delay(delay), _periodic(isPeriodic), f((void*)f), running(false), next(nullptr)
+    : f((void*)f), target(0), _delay(toTimerTicks(delay)), deadline(0), _periodic(isPeriodic), shard(0), _priority(0), running(false), cancelled(false), restarted(false), bucketed(false), pending(false), container(false), blocked(false)
 {}
 
 bool Timer::isRunning() const {
@@ -25,6 +31,10 @@ uint32_t Timer::delay() const {
     return _delay;
 }
 
+uint8_t Timer::priority() const {
+    return _priority;
+}
+
 void Timer::periodic(bool val){
     if (running) return; // can't change parameters directly if running
     _periodic = val;
@@ -32,9 +42,18 @@ void Timer::periodic(bool val){
 
 void Timer::delay(uint32_t val){
     if (running) return; // can't change parameters directly if running
-    _delay = val;
+    _delay = toTimerTicks(val);
+}
+
+void Timer::priority(uint8_t val){
+    if (running) return; // can't change parameters directly if running
+    _priority = val;
 }
 
 void Timer::fire(){
     ((callback_function)f)();
-}
\ No newline at end of file
+}
+
+void Timer::dispatch(const TimerFireInfo&){
+    fire();
+}
@@ -1,13 +1,58 @@
+#pragma once
 
 #include <cstdint>
 
+// Width of the stored counter values, 16 saves RAM on every timer if all controllers use 16 bit counters.
+// Define it for every translation unit (build flag: -D TIMERARRAY_TICK_BITS=16).
+#ifndef TIMERARRAY_TICK_BITS
+#define TIMERARRAY_TICK_BITS 32
+#endif
+
+#if TIMERARRAY_TICK_BITS == 16
+using timer_ticks_t = uint16_t;
+#elif TIMERARRAY_TICK_BITS == 32
+using timer_ticks_t = uint32_t;
+#else
+#error "TIMERARRAY_TICK_BITS must be 16 or 32"
+#endif
+
+static const uint8_t timer_ticks_bits = TIMERARRAY_TICK_BITS;
+static const uint32_t timer_ticks_max = (timer_ticks_t)~(timer_ticks_t)0;
+
+// Delays are stored in timer_ticks_t, longer ones saturate at timer_ticks_max instead of wrapping around.
+inline timer_ticks_t toTimerTicks(uint32_t ticks){
+    return ticks > timer_ticks_max ? (timer_ticks_t)timer_ticks_max : (timer_ticks_t)ticks;
+}
+
+class Timer;
+
+// Timing of a firing, passed to the callbacks of TimingTimer and ContextTimingTimer.
+// All values are in ticks of the controller.
+struct TimerFireInfo{
+    uint32_t scheduled; // counter value the timer was due at
+    uint32_t now; // counter value when the callback was dispatched, read for each callback of a batch
+    uint32_t lateness; // ticks passed between scheduled and now
+    uint32_t missed; // whole periods passed since scheduled (periodic timers only)
+};
+
+// Link of the timer feed, the feed's root is only a link instead of a full Timer.
+class TimerLink{
+public:
+    TimerLink() : next(nullptr) {}
+protected:
+    Timer* next;
+
+    friend class TimerArrayControl;
+};
+
 // Represents a timer, handled by a TimerArrayControl object.
 // Attach it to a controller to receive callbacks.
 //
-// delay: ticks of timer array controller until firing
+// delay: ticks of timer array controller until firing, at most timer_ticks_max (65535 with TIMERARRAY_TICK_BITS=16),
+//        a longer delay is saturated, delay() returns the stored value
 // periodic: does the timer restart immedietely when fires
 // f: static function called when timer is firing
-class Timer{
+class Timer : public TimerLink{
 public:
     using callback_function = void(*)();
     Timer(const callback_function f);
@@ -16,26 +61,43 @@ public:
     bool isRunning() const;
     bool isPeriodic() const;
     uint32_t delay() const;
+    uint8_t priority() const;
 
     void periodic(bool val);
-    void delay(uint32_t val);
+    void delay(uint32_t val); // saturated at timer_ticks_max
+    void priority(uint8_t val); // timers due in the same tick fire in decreasing priority, 0 by default, set it before attaching
 
     // Changing the timers delay will not affect the current firing event, only the next one.
     // To restart the timer with the new delay, detach and attach it.
     // To change the timer's delay without restart, use the changeTimerDelay method
     // in the TimerArrayControl.
+    // To push back a running timer with its full delay, use the restartTimer method.
 
 protected:
-    uint32_t _delay; // required delay of timer (in ticks)
-    bool _periodic; // should the timer be immedietely restarted after firing
-    uint32_t target; // counter value that the timer fires at next
+    // Members are ordered to avoid padding, see the size checks in Timer.cpp.
     void *const f; // WARNING: unsafe if you force the call of a certain fire method instead of letting the inheritance decide
-    bool running;
-    Timer* next;
+    timer_ticks_t target; // counter value that the timer fires at next
+    timer_ticks_t _delay; // required delay of timer (in ticks)
+    timer_ticks_t deadline; // counter value requested by the last restart, valid if restarted is set
+    bool _periodic; // should the timer be immedietely restarted after firing
+    uint8_t shard; // shard of the ShardedTimerArray the timer was last attached to
+    uint8_t _priority; // order of the timers due together, the highest fires first
+
+    // State flags, only modified by the controller with its interrupt disabled or from its interrupt.
+    bool running : 1;
+    bool cancelled : 1; // cancelTimer was called, the timer stays in the feed as a tombstone until it is unlinked
+    bool restarted : 1; // restartTimer was called, the timer should fire at deadline instead of target
+    bool bucketed : 1; // the timer is linked in a TimerBucket instead of the feed
+    bool pending : 1; // one-shot timer collected by tick to fire, a detach or cancel before its callback clears it
+    bool container : 1; // the node stands for other timers (TimerBucket), it is not counted as an attached timer
+    bool blocked : 1; // member of a TimerBlock, the controller leaves it alone
 
     virtual void fire();
+    virtual void dispatch(const TimerFireInfo& info); // called by the controller on expiry, fires by default
 
     friend class TimerArrayControl;
+    friend class ShardedTimerArray;
+    friend class TimerBlock;
 };
 
 // Represents a Timer with context.
@@ -57,3 +119,49 @@ protected:
         ((dynamic_callback_function)f)(ctx);
     }
 };
+
+// Represents a Timer whose callback receives the timing of the firing,
+// so periodic work can compensate for the jitter of the interrupt.
+// When fired manually or by a delay change, scheduled and now are both the current target.
+//
+// delay: ticks of timer array controller until firing
+// isPeriodic: does the timer restart immedietely when fires
+// tf: static function called when timer is firing, takes the timing of the firing
+class TimingTimer : public Timer{
+public:
+    using timing_callback_function = void(*)(const TimerFireInfo&);
+    TimingTimer(const timing_callback_function tf) : Timer((callback_function)tf) {}
+    TimingTimer(uint32_t delay, bool isPeriodic, const timing_callback_function tf) : Timer(delay, isPeriodic, (callback_function)tf) {}
+protected:
+    virtual void fire(){
+        TimerFireInfo info = {target, target, 0, 0};
+        ((timing_callback_function)f)(info);
+    }
+    virtual void dispatch(const TimerFireInfo& info){
+        ((timing_callback_function)f)(info);
+    }
+};
+
+// Represents a TimingTimer with context.
+//
+// delay: ticks of timer array controller until firing
+// isPeriodic: does the timer restart immedietely when fires
+// ctx: context pointer to an object, will be passed to the callback function
+// ctxf: static function called when timer is firing, takes a Context* pointer and the timing of the firing
+template<typename Context>
+class ContextTimingTimer : public Timer{
+public:
+    using dynamic_timing_callback_function = void(*)(Context*, const TimerFireInfo&);
+    ContextTimingTimer(Context* ctx, const dynamic_timing_callback_function ctxf) : Timer((callback_function)ctxf), ctx(ctx) {}
+    ContextTimingTimer(uint32_t delay, bool isPeriodic, Context* ctx, const dynamic_timing_callback_function ctxf) : Timer(delay, isPeriodic, (callback_function)ctxf), ctx(ctx) {}
+protected:
+    Context* ctx;
+
+    virtual void fire(){
+        TimerFireInfo info = {target, target, 0, 0};
+        ((dynamic_timing_callback_function)f)(ctx, info);
+    }
+    virtual void dispatch(const TimerFireInfo& info){
+        ((dynamic_timing_callback_function)f)(ctx, info);
+    }
+};
@@ -0,0 +1,87 @@
+#include "TimerAnalyzer.hpp"
+
+// -----                              -----
+// ----- TimerAnalyzer implementation -----
+// -----                              -----
+
+static uint64_t gcd(uint64_t a, uint64_t b){
+    while (b){
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// first expiry of the timer at or after t
+static uint64_t nextExpiry(const TimerLoad& load, uint64_t t){
+    if (t <= load.phase) return load.phase;
+    return load.phase + (t - load.phase + load.delay - 1) / load.delay * load.delay;
+}
+
+TimerAnalysis analyzeTimerLoad(const TimerLoad* loads, uint16_t count, uint32_t callbackJitter, uint64_t maxHorizon){
+    TimerAnalysis result = {};
+
+    // hyperperiod is the least common multiple of the periods, utilization is the sum of cost/period
+    uint64_t hyperperiod = 1;
+    uint64_t maxPhase = 0;
+    uint64_t utilization = 0;
+    for (uint16_t i = 0; i < count; ++i){
+        if (!loads[i].delay) continue;
+
+        if (hyperperiod){
+            uint64_t factor = loads[i].delay / gcd(hyperperiod, loads[i].delay);
+            hyperperiod = hyperperiod > UINT64_MAX / factor ? 0 : hyperperiod * factor;
+        }
+        if (loads[i].phase > maxPhase) maxPhase = loads[i].phase;
+        utilization += (uint64_t)loads[i].cost * 1000 / loads[i].delay;
+    }
+    result.hyperperiod = hyperperiod;
+    result.utilization = utilization > UINT32_MAX ? UINT32_MAX : (uint32_t)utilization;
+
+    // after the last phase the pattern is periodic, one hyperperiod covers every coincidence
+    uint64_t horizon = maxHorizon;
+    if (hyperperiod && maxPhase < maxHorizon && hyperperiod <= maxHorizon - maxPhase){
+        horizon = maxPhase + hyperperiod;
+        result.complete = true;
+    }
+    result.horizon = horizon;
+
+    uint64_t busyUntil = 0; // the callbacks of the previous expiries run until this tick
+    uint64_t busyStart = 0;
+    uint64_t t = 0;
+
+    while (1){
+        // find the next tick with expiries
+        uint64_t tick = UINT64_MAX;
+        for (uint16_t i = 0; i < count; ++i){
+            if (!loads[i].delay) continue;
+            uint64_t next = nextExpiry(loads[i], t);
+            if (next < tick) tick = next;
+        }
+        if (tick == UINT64_MAX || tick >= horizon) break;
+
+        // run the callbacks of the tick one after the other
+        uint16_t expiries = 0;
+        if (busyUntil <= tick) busyStart = tick;
+        for (uint16_t i = 0; i < count; ++i){
+            if (!loads[i].delay || nextExpiry(loads[i], tick) != tick) continue;
+            ++expiries;
+
+            uint64_t start = busyUntil > tick ? busyUntil : tick;
+            if (start - tick > result.requiredJitter) result.requiredJitter = (uint32_t)(start - tick > UINT32_MAX ? UINT32_MAX : start - tick);
+            busyUntil = start + loads[i].cost;
+        }
+
+        if (expiries > result.peakExpiries){
+            result.peakExpiries = expiries;
+            result.peakTick = tick;
+        }
+        if (busyUntil - busyStart > result.longestBusy) result.longestBusy = busyUntil - busyStart;
+
+        t = tick + 1;
+    }
+
+    result.overload = result.utilization > 1000 || result.requiredJitter >= callbackJitter;
+    return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// A periodic timer as seen by the analyzer, in ticks of the controller.
+// TimerArrayControl::periodicLoads fills them from the attached timers,
+// or they can be written by hand to check a timer set on the host before deploying it.
+struct TimerLoad{
+    uint32_t delay; // period
+    uint32_t phase; // ticks until the first expiry
+    uint32_t cost; // measured or estimated run time of the callback, 0 if unknown
+};
+
+// Result of analyzeTimerLoad, time values are in ticks.
+struct TimerAnalysis{
+    uint64_t hyperperiod; // the expiry pattern repeats after it, 0 if it does not fit 64 bits
+    uint64_t horizon; // ticks simulated, the transient of the phases and one hyperperiod if it fits the limit
+    bool complete; // the whole horizon was simulated, the results are worst cases
+    uint16_t peakExpiries; // most timers expiring at the same tick
+    uint64_t peakTick; // first tick with peakExpiries expiries
+    uint64_t longestBusy; // longest time the callbacks run back to back
+    uint32_t requiredJitter; // the latest start of a callback after its expiry, CALLBACK_JITTER must be larger
+    uint32_t utilization; // callback run time per tick, in 1/1000
+    bool overload; // utilization above 100% or the jitter limit is exceeded, timers will be late or missed
+};
+
+// Simulate the expiries of periodic timers, the callbacks are run one after the other like in the interrupt.
+// The run time grows with the number of expiries in the horizon, limit it with maxHorizon on the device.
+//
+// loads: the timers, periods of 0 are skipped
+// count: number of timers
+// callbackJitter: CALLBACK_JITTER of the controller, used for the overload warning
+// maxHorizon: upper limit of the simulated ticks
+TimerAnalysis analyzeTimerLoad(const TimerLoad* loads, uint16_t count, uint32_t callbackJitter=1000, uint64_t maxHorizon=((uint64_t)1 << 24));
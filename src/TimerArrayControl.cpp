@@ -1,4 +1,6 @@
 #include "TimerArrayControl.hpp"
+#include "CriticalSection.hpp"
+#include "TimerCapture.hpp"
 
 // capture update events and fire the timer array's callback chain
 // a single call to tick would suffice in case of one timer array,
@@ -11,26 +13,63 @@ void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim){
 
 #define TARGET_CC_CHANNEL (TIM_CHANNEL_1)
 #define __HAL_IS_TIMER_ENABLED(htim) (htim->Instance->CR1 & TIM_CR1_CEN)
-#define __HAL_GENERATE_INTERRUPT(htim, EGR_FLAG) (htim->Instance->EGR |= TIM_EGR_CC1G)
+#define __HAL_GENERATE_INTERRUPT(htim, EGR_FLAG) (htim->Instance->EGR = htim->Instance->EGR | TIM_EGR_CC1G)
 #define COUNTER_MODULO(x) (timerFeed.max_count & ((uint32_t)(x)))
 #define DISABLE_INTERRUPT() (__HAL_TIM_DISABLE_IT(timerFeed.htim, TIM_IT_CC1))
 #define ENABLE_INTERRUPT() (__HAL_TIM_ENABLE_IT(timerFeed.htim, TIM_IT_CC1))
-#define SET_TARGET(val) (__HAL_TIM_SET_COMPARE(htim, TARGET_CC_CHANNEL, val))
-#define GET_TARGET(val) (__HAL_TIM_GET_COMPARE(htim, TARGET_CC_CHANNEL))
+#define SEQUENCE_STEP() (__DMB(), timerFeed.stepSequence(), __DMB()) // odd while the feed is modified
+#define BEGIN_UPDATE() (DISABLE_INTERRUPT(), SEQUENCE_STEP())
+#define END_UPDATE() (SEQUENCE_STEP(), ENABLE_INTERRUPT())
+#define TO_COUNTER(val) (max_count & ((uint32_t)((val) + epoch))) // hardware counter value of a feed time
+#define GET_TIME() (max_count & ((uint32_t)(__HAL_TIM_GET_COUNTER(htim) - epoch))) // feed time, the counter shifted back by the epoch
+#define SET_TARGET(val) (TRACE_TARGET(TO_COUNTER(val)), __HAL_TIM_SET_COMPARE(htim, TARGET_CC_CHANNEL, TO_COUNTER(val)))
+#define GET_TARGET(val) (max_count & ((uint32_t)(__HAL_TIM_GET_COMPARE(htim, TARGET_CC_CHANNEL) - epoch)))
 #define CALLBACK_JITTER 1000
+#ifdef TIMERARRAY_TRACE
+#define TRACE(type, timer, arg) (timerFeed.trace.record(TimerTrace::type, __HAL_TIM_GET_COUNTER(timerFeed.htim), (uint32_t)(uintptr_t)(timer), arg))
+#define TRACE_TARGET(val) (trace.record(TimerTrace::CCR_WRITE, __HAL_TIM_GET_COUNTER(htim), val, 0))
+#else
+#define TRACE(type, timer, arg) ((void)0)
+#define TRACE_TARGET(val) ((void)0)
+#endif
+const uint32_t TimerArrayControl::callback_jitter = CALLBACK_JITTER;
+
+#ifndef TICK_BATCH_SIZE
+#define TICK_BATCH_SIZE 8 // due timers collected before their callbacks are run
+#endif
+#ifndef MAX_TOMBSTONES
+#define MAX_TOMBSTONES 16 // cancelled timers allowed in the feed before they are removed in one pass
+#endif
 
 // -----                            -----
 // ----- TimerString implementation -----
 // -----                            -----
 
 TimerArrayControl::TimerFeed::TimerFeed(TIM_HandleTypeDef *const htim, const uint8_t bits) :
-    root(nullptr),
+    root(),
     htim(htim),
-    bits(bits)
+    bits(bits > timer_ticks_bits ? timer_ticks_bits : bits),
+    epoch(0),
+    sequence(0),
+    now(0),
+    tombstones(0),
+    timerCount(0),
+    prioritized(0),
+    buckets(nullptr),
+    bucketCount(0),
+    outputChannels(0),
+    deferTarget(false),
+    targetDirty(false)
 {}
 
-Timer* TimerArrayControl::TimerFeed::findTimerInsertionLink(Timer* it, Timer* timer){
+TimerLink* TimerArrayControl::TimerFeed::findTimerInsertionLink(TimerLink* it, Timer* timer){
     while(it->next && isSooner(it->next->target, timer->target)){
+        if (it->next->cancelled){
+            // cancelled timers on the way are unlinked for free
+            unlinkTimer(it, it->next);
+            continue;
+        }
+
         // while there are more timers and the next timer's target is sooner than the new one's
         // advance it on the timer string
         it = it->next;
@@ -39,43 +78,172 @@ Timer* TimerArrayControl::TimerFeed::findTimerInsertionLink(Timer* it, Timer* ti
 }
 
 // insert timer after the iterator
-void TimerArrayControl::TimerFeed::insertTimer(Timer* it, Timer* timer){
+void TimerArrayControl::TimerFeed::insertTimer(TimerLink* it, Timer* timer){
     
     // insert the new timer between it and next of it
+    if (!timer->running) countTimer(timer, 1);
     timer->running = true;
+    timer->restarted = false;
+    timer->pending = false; // attached again by a callback of its batch, it fires after the new delay
     timer->next = it->next;
     it->next = timer;
 
     // if the first timer changed, adjust interrupt target
-    if (root.next == timer) SET_TARGET(timer->target);
+    if (root.next == timer) setTarget(timer->target);
 }
 
 // insert timer based on target
 void TimerArrayControl::TimerFeed::insertTimer(Timer* timer){
+
+    // a cancelled timer is still linked, take it out before inserting it again
+    if (timer->cancelled) removeTimer(timer);
+
+    // periodic timers go to the bucket of their period if possible
+    if (timer->_periodic && bucketCount){
+        TimerBucket* bucket = findBucket(timer->_delay, true);
+        if (bucket){
+            bucketInsert(bucket, timer);
+            return;
+        }
+    }
+
+    Timer* first = root.next;
     insertTimer(findTimerInsertionLink(&root, timer), timer);
+
+    // if cancelled timers were unlinked from the front, the first timer changed without insertion
+    if (root.next != first && root.next != timer) setTarget(root.next->target);
 }
 
-// remove timer from feed
-void TimerArrayControl::TimerFeed::removeTimer(Timer* timer){
-    Timer* it = &root;
-    while(it->next && it->next != timer) it = it->next;
+// remove timer from feed, false if it is not linked in this feed
+bool TimerArrayControl::TimerFeed::removeTimer(Timer* timer){
+    if (timer->bucketed){
+        TimerBucket* bucket = findBucket(timer->_delay, false);
+        if (bucketRemove(bucket, timer)) return true;
 
-    if (it->next == timer){
-        it->next = timer->next;
-        timer->next = nullptr;
-        timer->running = false;
+        // the delay of a cancelled timer can be changed while it is linked, search the other buckets
+        for (uint8_t i = 0; i < bucketCount; ++i){
+            if (&buckets[i] != bucket && bucketRemove(&buckets[i], timer)) return true;
+        }
+        return false;
     }
 
+    TimerLink* it = &root;
+    while(it->next && it->next != timer) it = it->next;
+
+    if (it->next != timer) return false;
+    unlinkTimer(it, timer);
+
     // if the removed timer was the first in the feed, update interrupt target
-    if (&root == it && root.next) SET_TARGET(root.next->target);
+    if (&root == it && root.next) setTarget(root.next->target);
+    return true;
+}
+
+bool TimerArrayControl::TimerFeed::claimTimer(Timer* timer){
+    if (!timer->cancelled) return true;
+
+    // the tombstone is unlinked here, if it was cancelled on this controller
+    return removeTimer(timer);
+}
+
+void TimerArrayControl::TimerFeed::unlinkTimer(TimerLink* it, Timer* timer){
+    it->next = timer->next;
+    timer->next = nullptr;
+    releaseTimer(timer);
+}
+
+void TimerArrayControl::TimerFeed::releaseTimer(Timer* timer){
+    if (timer->running) countTimer(timer, -1);
+    timer->running = false;
+    timer->restarted = false;
+    timer->bucketed = false;
+
+    if (timer->cancelled){
+        timer->cancelled = false;
+        --tombstones;
+    }
+}
+
+void TimerArrayControl::TimerFeed::countTimer(Timer* timer, int8_t change){
+    // buckets are only containers of the attached timers
+    if (timer->container) return;
+    timerCount += change;
+    if (timer->_priority) prioritized += change;
+}
+
+TimerLink* TimerArrayControl::TimerFeed::highestDueLink(){
+    TimerLink* best = &root;
+
+    // the due timers are a prefix of the feed, ties keep the feed order
+    for (TimerLink* it = &root; it->next; it = it->next){
+        if ((max_count & ((uint32_t)(cnt - it->next->target))) >= CALLBACK_JITTER) break;
+        if (it->next->_priority > best->next->_priority) best = it;
+    }
+    return best;
+}
+
+void TimerArrayControl::TimerFeed::removeTombstones(){
+    Timer* first = root.next;
+
+    TimerLink* it = &root;
+    while(it->next){
+        if (it->next->cancelled) unlinkTimer(it, it->next);
+        else it = it->next;
+    }
+
+    for (uint8_t i = 0; i < bucketCount; ++i){
+        Timer* timer = buckets[i].head;
+        while(timer){
+            Timer* next = timer->next;
+            if (timer->cancelled) bucketRemove(&buckets[i], timer);
+            timer = next;
+        }
+    }
+
+    if (root.next != first) updateHeadTarget();
+}
+
+uint32_t TimerArrayControl::TimerFeed::headTarget() const{
+    // if no timers to fire yet, set max delay between unneeded interrupts
+    return root.next == nullptr ? (max_count & ((uint32_t)(cnt - 1))) : root.next->target;
+}
+
+void TimerArrayControl::TimerFeed::updateHeadTarget(){
+    setTarget(headTarget());
+}
+
+void TimerArrayControl::TimerFeed::setTarget(uint32_t target){
+    if (deferTarget){
+        // tick writes the final target once
+        targetDirty = true;
+        return;
+    }
+    SET_TARGET(target);
+}
+
+void TimerArrayControl::TimerFeed::commitTarget(){
+    if (!targetDirty) return;
+    targetDirty = false;
+    SET_TARGET(headTarget());
+}
+
+bool TimerArrayControl::TimerFeed::isHeadDue() const{
+    return root.next && (max_count & ((uint32_t)(cnt - root.next->target))) < CALLBACK_JITTER;
 }
 
 // remove and insert timer in one operation, according to it's target
 void TimerArrayControl::TimerFeed::updateTimerTarget(Timer* timer, uint32_t target){
+
+    // a bucketed timer keeps its period, it only moves inside its bucket
+    if (timer->bucketed){
+        removeTimer(timer);
+        timer->target = target;
+        insertTimer(timer);
+        return;
+    }
     
     // find fitting place for timer in string
-    Timer* ins = &root;
-    Timer* rem = ins;
+    TimerLink* ins = &root;
+    TimerLink* rem = ins;
 
     // search attach position
     while(ins->next && isSooner(ins->next->target, target)){
@@ -109,7 +277,175 @@ void TimerArrayControl::TimerFeed::updateTimerTarget(Timer* timer, uint32_t targ
     // If both, the first timers target was probably changed.
     // In all cases new target is needed.
     if (&root == ins || &root == rem) {
-        SET_TARGET(root.next->target);
+        setTarget(root.next->target);
+    }
+}
+
+void TimerArrayControl::TimerFeed::applyRestart(Timer* timer){
+    if (!timer->restarted) return;
+    timer->restarted = false;
+    updateTimerTarget(timer, timer->deadline);
+}
+
+TimerBucket* TimerArrayControl::TimerFeed::findBucket(uint32_t delay, bool claim){
+    TimerBucket* free = nullptr;
+    for (uint8_t i = 0; i < bucketCount; ++i){
+        TimerBucket* bucket = &buckets[i];
+        if (bucket->isEmpty()){
+            if (!free) free = bucket;
+        } else if (bucket->_delay == delay){
+            return bucket;
+        }
+    }
+
+    if (!claim || !free) return nullptr;
+    free->_delay = delay;
+    return free;
+}
+
+void TimerArrayControl::TimerFeed::bucketInsert(TimerBucket* bucket, Timer* timer){
+    if (!timer->running) countTimer(timer, 1);
+    timer->running = true;
+    timer->restarted = false;
+    timer->bucketed = true;
+
+    if (!bucket->head){
+        // first timer of the bucket, the bucket enters the feed
+        timer->next = nullptr;
+        bucket->head = bucket->tail = timer;
+        bucketHeadChanged(bucket, timer);
+        return;
+    }
+
+    if (!isSooner(timer->target, bucket->tail->target)){
+        // usual case, timers with the same period arrive in order
+        timer->next = nullptr;
+        bucket->tail->next = timer;
+        bucket->tail = timer;
+        return;
+    }
+
+    // the timer was late or attached in sync, search its place
+    if (isSooner(timer->target, bucket->head->target)){
+        timer->next = bucket->head;
+        bucket->head = timer;
+        bucketHeadChanged(bucket, timer);
+        return;
+    }
+
+    Timer* it = bucket->head;
+    while(it->next && !isSooner(timer->target, it->next->target)) it = it->next;
+    timer->next = it->next;
+    it->next = timer;
+}
+
+bool TimerArrayControl::TimerFeed::bucketRemove(TimerBucket* bucket, Timer* timer){
+    if (!bucket || !bucket->head) return false;
+
+    if (bucket->head == timer){
+        bucket->head = timer->next;
+        if (!bucket->head) bucket->tail = nullptr;
+        timer->next = nullptr;
+        releaseTimer(timer);
+        bucketHeadChanged(bucket, bucket->head);
+        return true;
+    }
+
+    Timer* it = bucket->head;
+    while(it && it->next != timer) it = it->next;
+    if (!it) return false;
+
+    it->next = timer->next;
+    if (bucket->tail == timer) bucket->tail = it;
+    timer->next = nullptr;
+    releaseTimer(timer);
+    return true;
+}
+
+void TimerArrayControl::TimerFeed::bucketHeadChanged(TimerBucket* bucket, Timer* head){
+    if (!head){
+        // empty bucket leaves the feed and becomes free
+        if (bucket->running) removeTimer(bucket);
+        return;
+    }
+
+    if (bucket->running){
+        updateTimerTarget(bucket, head->target);
+    } else {
+        bucket->target = head->target;
+        insertTimer(bucket);
+    }
+}
+
+void TimerArrayControl::TimerFeed::fireBucket(TimerBucket* bucket, const TimerFireInfo& info){
+    // the bucket was taken out of the feed by tick, its first timer is due
+    Timer* timer = bucket->head;
+    bucket->head = timer->next;
+    if (!bucket->head) bucket->tail = nullptr;
+    timer->next = nullptr;
+
+    bool fire = true;
+
+    if (timer->cancelled){
+        // drop a cancelled timer without firing
+        releaseTimer(timer);
+        fire = false;
+    } else {
+        if (timer->restarted){
+            // fire at the real deadline if it is still ahead
+            fire = (max_count & ((uint32_t)(cnt - timer->deadline))) < CALLBACK_JITTER;
+            timer->target = timer->deadline;
+        }
+
+        // re-arm is a move to the end of the bucket
+        if (fire) timer->target = max_count & ((uint32_t)(timer->target + timer->_delay));
+        bucketInsert(bucket, timer);
+    }
+
+    // put the bucket back in the feed at its new first timer,
+    // unless the insertion to an empty bucket already did
+    if (bucket->head && !bucket->running){
+        bucket->target = bucket->head->target;
+        insertTimer(bucket);
+    }
+
+    if (fire){
+        // the bucket is not periodic itself, missed periods are counted with the timer's delay
+        TimerFireInfo timer_info = info;
+        timer_info.missed = timer->_delay ? info.lateness / timer->_delay : 0;
+        timer->dispatch(timer_info);
+    }
+}
+
+void TimerArrayControl::TimerFeed::scheduleEdge(OutputCompareTimer* timer, uint32_t time){
+    uint32_t edge = max_count & (time + timer->lead);
+
+    if (timer->edge == OutputCompareTimer::TOGGLE) timer->_level = !timer->_level;
+    else timer->_level = timer->edge == OutputCompareTimer::SET;
+
+    // the active and inactive modes only drive the pin to a level on match,
+    // a second match at the same level after a counter overflow changes nothing
+    __HAL_TIM_SET_COMPARE(htim, timer->_channel, TO_COUNTER(edge));
+    setOutputMode(timer->_channel, timer->_level ? TIM_OCMODE_ACTIVE : TIM_OCMODE_INACTIVE);
+
+    // if the edge passed before it was programmed, force the level now
+    if ((max_count & ((uint32_t)(GET_TIME() - edge))) < CALLBACK_JITTER){
+        setOutputMode(timer->_channel, timer->_level ? TIM_OCMODE_FORCED_ACTIVE : TIM_OCMODE_FORCED_INACTIVE);
+    }
+}
+
+void TimerArrayControl::TimerFeed::setOutputMode(uint32_t channel, uint32_t mode){
+    // channels 1-2 are configured in CCMR1, 3-4 in CCMR2, the even channels in the upper byte
+    volatile uint32_t* ccmr = channel < TIM_CHANNEL_3 ? &htim->Instance->CCMR1 : &htim->Instance->CCMR2;
+    uint32_t shift = (channel == TIM_CHANNEL_2 || channel == TIM_CHANNEL_4) ? 8 : 0;
+    *ccmr = (*ccmr & ~(TIM_CCMR1_OC1M << shift)) | (mode << shift);
+}
+
+void TimerArrayControl::TimerFeed::shiftEdges(uint32_t delta){
+    // an edge that already passed moves too, its second match at the same level changes nothing
+    for (uint32_t channel = TIM_CHANNEL_2; channel <= TIM_CHANNEL_4; channel += 4){
+        if (!(outputChannels & (1u << (channel >> 2)))) continue;
+        __HAL_TIM_SET_COMPARE(htim, channel, max_count & ((uint32_t)(__HAL_TIM_GET_COMPARE(htim, channel) + delta)));
     }
 }
 
@@ -118,12 +454,14 @@ bool TimerArrayControl::TimerFeed::isSooner(uint32_t target, uint32_t reference)
 }
 
 void TimerArrayControl::TimerFeed::updateTime(){
-    cnt = __HAL_TIM_GET_COUNTER(htim);
+    cnt = GET_TIME();
+    now = cnt;
 }
 
 void TimerArrayControl::TimerFeed::updateTickTime(){
     cnt = GET_TARGET();
-    uint32_t tim_cnt = __HAL_TIM_GET_COUNTER(htim);
+    uint32_t tim_cnt = GET_TIME();
+    now = tim_cnt;
     
     if ((max_count & ((uint32_t)(tim_cnt - cnt))) >= CALLBACK_JITTER){
         // if CNT passed CCR more than the acceptable jitter, use the CNT value
@@ -131,6 +469,90 @@ void TimerArrayControl::TimerFeed::updateTickTime(){
     }
 }
 
+uint32_t TimerArrayControl::TimerFeed::time() const{
+    return GET_TIME();
+}
+
+TimerFireInfo TimerArrayControl::TimerFeed::fireInfo(uint32_t scheduled, const Timer* timer) const{
+    TimerFireInfo info;
+    info.scheduled = scheduled;
+    info.now = GET_TIME(); // the earlier callbacks of the batch took time, now is read for every one
+    info.lateness = max_count & ((uint32_t)(info.now - scheduled));
+    info.missed = (timer->_periodic && timer->_delay) ? info.lateness / timer->_delay : 0;
+    return info;
+}
+
+bool TimerArrayControl::TimerFeed::nextDeadline(uint32_t& target) const{
+    bool found = false;
+    for (Timer* it = root.next; it; it = it->next){
+        if (it->cancelled) continue;
+
+        // the feed is sorted by target and a noted deadline is never sooner than its target (registerRestart
+        // moves the other timers at once), nothing after a timer targeted later than the found deadline can come sooner
+        if (found && (max_count & ((uint32_t)(it->target - cnt))) >= (max_count & ((uint32_t)(target - cnt)))) break;
+
+        uint32_t deadline = it->restarted ? it->deadline : it->target;
+        if (!found || (max_count & ((uint32_t)(deadline - cnt))) < (max_count & ((uint32_t)(target - cnt)))){
+            target = deadline;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TimerArrayControl::TimerFeed::addLoad(const Timer* timer, TimerLoad* loads, uint16_t max, uint16_t& count) const{
+    if (!timer->_periodic || timer->cancelled) return;
+
+    if (count < max){
+        const uint32_t target = timer->restarted ? timer->deadline : timer->target;
+        loads[count].delay = timer->_delay;
+        loads[count].phase = max_count & ((uint32_t)(target - cnt));
+        loads[count].cost = 0;
+    }
+    ++count;
+}
+
+void TimerArrayControl::TimerFeed::rescale(uint64_t num, uint64_t den){
+    // the conversion is monotonic, the order of the feed and the buckets stays valid
+    for (Timer* it = root.next; it; it = it->next) rescaleTimer(it, num, den);
+    for (uint8_t i = 0; i < bucketCount; ++i){
+        for (Timer* it = buckets[i].head; it; it = it->next) rescaleTimer(it, num, den);
+    }
+}
+
+void TimerArrayControl::TimerFeed::rescaleTimer(Timer* timer, uint64_t num, uint64_t den){
+    timer->_delay = rescaleTicks(timer->_delay, num, den);
+
+    // a due timer stays due
+    if ((max_count & ((uint32_t)(cnt - timer->target))) >= CALLBACK_JITTER){
+        timer->target = max_count & (cnt + rescaleTicks(max_count & ((uint32_t)(timer->target - cnt)), num, den));
+    }
+    if (timer->restarted){
+        timer->deadline = max_count & (cnt + rescaleTicks(max_count & ((uint32_t)(timer->deadline - cnt)), num, den));
+    }
+}
+
+void TimerArrayControl::TimerFeed::rescaleEdges(uint64_t num, uint64_t den){
+    for (uint32_t channel = TIM_CHANNEL_2; channel <= TIM_CHANNEL_4; channel += 4){
+        if (!(outputChannels & (1u << (channel >> 2)))) continue;
+
+        // an edge that just passed stays, a pending one keeps its time like the targets
+        const uint32_t edge = max_count & ((uint32_t)(__HAL_TIM_GET_COMPARE(htim, channel) - epoch));
+        if ((max_count & ((uint32_t)(cnt - edge))) < CALLBACK_JITTER) continue;
+        const uint32_t scaled = max_count & (cnt + rescaleTicks(max_count & ((uint32_t)(edge - cnt)), num, den));
+        __HAL_TIM_SET_COMPARE(htim, channel, TO_COUNTER(scaled));
+    }
+}
+
+uint32_t TimerArrayControl::TimerFeed::rescaleTicks(uint32_t ticks, uint64_t num, uint64_t den) const{
+    uint64_t scaled;
+    if (ticks && num > UINT64_MAX / ticks) scaled = (uint64_t)((double)ticks * num / den); // rare, only for huge ratios
+    else scaled = (ticks * num + den / 2) / den;
+
+    const uint32_t limit = max_count - CALLBACK_JITTER;
+    return scaled > limit ? limit : (uint32_t)scaled;
+}
+
 uint32_t TimerArrayControl::TimerFeed::calculateNextFireInSync(uint32_t target, uint32_t delay) const{
     uint32_t diff = (max_count & ((uint32_t)(cnt - target)));
     uint32_t subt = diff - (diff/delay)*delay;
@@ -145,10 +567,18 @@ uint32_t TimerArrayControl::TimerFeed::calculateNextFireInSync(uint32_t target,
 
 
 TimerArrayControl::TimerArrayControl(TIM_HandleTypeDef *const htim, const uint32_t fclk, const uint32_t clkdiv, const uint8_t bits) : 
-    fclk(fclk),
-    clkdiv(clkdiv),
+    _fclk(fclk),
+    _clkdiv(clkdiv),
     timerFeed(htim, bits),
-    isTickOngoing(false)
+    isTickOngoing(false),
+    timerPool(nullptr),
+    suspended(false),
+    budgetCallbacks(0),
+    budgetTicks(0),
+    slices(0),
+    idleHook(nullptr),
+    idleContext(nullptr),
+    wakeupLatency(0)
 {}
 
 void TimerArrayControl::begin(){
@@ -161,15 +591,17 @@ void TimerArrayControl::begin(){
     timerFeed.htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE; // by disabling, write to ARR shadow regs happens immedietely
     #endif
     timerFeed.htim->Init.Period = timerFeed.max_count; // set max period for maximum amount of possible delay
-    timerFeed.htim->Init.Prescaler = prescaler - 1; // prescaler divides clock by Prescaler+1
+    timerFeed.htim->Init.Prescaler = _prescaler - 1; // prescaler divides clock by Prescaler+1
 
-    TIM_OC_InitTypeDef oc_init;
+    TIM_OC_InitTypeDef oc_init = {};
     oc_init.OCMode = TIM_OCMODE_TIMING;
 
     HAL_TIM_OC_Init(timerFeed.htim);
     HAL_TIM_OC_ConfigChannel(timerFeed.htim, &oc_init, TARGET_CC_CHANNEL);
-    uint32_t cnt = __HAL_TIM_GET_COUNTER(timerFeed.htim);
+    uint32_t cnt = timerFeed.time();
     uint32_t target = timerFeed.root.next == nullptr ? (timerFeed.max_count & (cnt-1)) : timerFeed.root.next->target;
+    target = COUNTER_MODULO(target + timerFeed.epoch); // the compare register is not shifted by the epoch
+    TRACE(CCR_WRITE, target, 0);
     __HAL_TIM_SET_COMPARE(timerFeed.htim, TARGET_CC_CHANNEL, target); // if no timers to fire yet, set max delay between unneeded interrupts
     HAL_TIM_OC_Start_IT(timerFeed.htim, TARGET_CC_CHANNEL);
 }
@@ -179,6 +611,21 @@ void TimerArrayControl::stop(){
     HAL_TIM_OC_Stop_IT(timerFeed.htim, TARGET_CC_CHANNEL);
 }
 
+void TimerArrayControl::suspend(){
+    if (suspended || !isRunning()) return;
+
+    // only the counter is stopped, the compare setup and the targets stay untouched
+    // (__HAL_TIM_DISABLE would not stop the counter while a channel is enabled)
+    timerFeed.htim->Instance->CR1 = timerFeed.htim->Instance->CR1 & ~TIM_CR1_CEN;
+    suspended = true;
+}
+
+void TimerArrayControl::resume(){
+    if (!suspended) return;
+    suspended = false;
+    timerFeed.htim->Instance->CR1 = timerFeed.htim->Instance->CR1 | TIM_CR1_CEN;
+}
+
 /*
  * Subscribed to interrupts generated by timerFeed.htim.
  * Only call tick if really timerFeed.htim was the source.
@@ -188,17 +635,46 @@ void TimerArrayControl::chainedCallback(TIM_HandleTypeDef* htim){
 }
 
 /**
- * This method can only be called from interupts.
+ * Takes the due timers from the front of the feed into batch, at most max of them.
+ * Periodic timers are re-armed, the others are unlinked.
+ * The interrupt target is not written, tick does it once for the batch.
  * */
-void TimerArrayControl::tick(){
+uint8_t TimerArrayControl::collectDueTimers(DueTimer* batch, uint8_t max){
 
-    isTickOngoing = true;
+    uint8_t count = 0;
 
-    timerFeed.updateTickTime();
+    while (count < max && timerFeed.root.next){
+        // the whole due part of the feed is ordered by priority, not only the batch
+        TimerLink* link = timerFeed.prioritized ? timerFeed.highestDueLink() : &timerFeed.root;
+        Timer* timer = link->next;
+
+        if (timer->cancelled){
+            // drop cancelled timers without firing
+            timerFeed.unlinkTimer(link, timer);
+            timerFeed.updateHeadTarget();
+            continue;
+        }
+
+        // stop at the first timer that is not due yet
+        if (COUNTER_MODULO(timerFeed.cnt - timer->target) >= CALLBACK_JITTER) break;
 
-    // handle timeout
-    while (timerFeed.root.next && COUNTER_MODULO(timerFeed.cnt - timerFeed.root.next->target) < CALLBACK_JITTER){
-        Timer* timer = timerFeed.root.next;
+        if (timer->restarted){
+            timer->restarted = false;
+
+            if (COUNTER_MODULO(timerFeed.cnt - timer->deadline) >= CALLBACK_JITTER){
+                // the timer was restarted since it was placed, its real deadline is still ahead,
+                // move it there instead of firing
+                timerFeed.updateTimerTarget(timer, timer->deadline);
+                continue;
+            }
+
+            // the real deadline is due as well, fire as if it was placed there
+            timer->target = timer->deadline;
+        }
+
+        batch[count].timer = timer;
+        batch[count].scheduled = timer->target; // the periodic re-arm overwrites it
+        ++count;
 
         // set up the next interrupt generation
         if (timer->_periodic){
@@ -211,49 +687,160 @@ void TimerArrayControl::tick(){
 
         } else {
             // if timer is not periodic, it is done, we can detach it
-            Timer* timer = timerFeed.root.next;
-            timer->running = false;
-            timerFeed.root.next = timer->next;
-            timer->next = nullptr;
+            // until its callback runs, a detach or cancel from an earlier callback can still stop it
+            timerFeed.unlinkTimer(link, timer);
+            timerFeed.updateHeadTarget();
+            timer->pending = true;
         }
+    }
+
+    return count;
+}
 
-        // set the new target
-        uint32_t target = timerFeed.root.next == nullptr ? COUNTER_MODULO(timerFeed.cnt - 1) : timerFeed.root.next->target;
-        __HAL_TIM_SET_COMPARE(timerFeed.htim, TARGET_CC_CHANNEL, target);
+/**
+ * This method can only be called from interupts.
+ * Expiry runs in two phases: due timers are collected and re-armed first,
+ * the comparator is programmed once, then the callbacks are run in decreasing priority.
+ * Timers attached from the callbacks are merged into the target at the next round.
+ * */
+void TimerArrayControl::tick(){
+
+    isTickOngoing = true;
+    SEQUENCE_STEP();
+    timerFeed.deferTarget = true;
+
+    timerFeed.updateTickTime();
+
+    const uint32_t start = timerFeed.now;
+    uint16_t fired = 0;
+
+    while (1){
+        DueTimer batch[TICK_BATCH_SIZE];
+        uint8_t max = TICK_BATCH_SIZE;
+
+        if (budgetCallbacks || budgetTicks){
+            if ((budgetCallbacks && fired >= budgetCallbacks) || (budgetTicks && COUNTER_MODULO(timerFeed.now - start) >= budgetTicks)){
+                // budget used up, let the other interrupts run and continue in a new interrupt
+                timerFeed.commitTarget();
+                if (timerFeed.isHeadDue()){
+                    __HAL_GENERATE_INTERRUPT(timerFeed.htim, TIM_EGR_CC1G);
+                    ++slices;
+                }
+                break;
+            }
+            if (budgetCallbacks && budgetCallbacks - fired < max) max = budgetCallbacks - fired;
+        }
+
+        // phase 1: collect and re-arm the due timers
+        uint8_t count = collectDueTimers(batch, max);
+
+        // single comparator write for the batch and for the changes made by the previous callbacks
+        timerFeed.commitTarget();
+
+        if (count == 0){
+            // the first timer might have passed while the comparator was written
+            timerFeed.updateTime();
+            if (!timerFeed.isHeadDue()) break;
+            continue;
+        }
 
-        // fire callback
-        timer->fire();
+        // phase 2: run the callbacks
+        for (uint8_t i = 0; i < count; ++i){
+            Timer* timer = batch[i].timer;
+
+            // a timer detached or cancelled by a previous callback is not fired
+            if (timer->_periodic ? !timer->running : !timer->pending) continue;
+            timer->pending = false;
+
+#ifdef TIMERARRAY_TRACE
+            {
+                uint32_t now = __HAL_TIM_GET_COUNTER(timerFeed.htim);
+                uint32_t lateness = COUNTER_MODULO(timerFeed.time() - batch[i].scheduled);
+                timerFeed.trace.record(lateness > TIMERARRAY_TRACE_LATE ? TimerTrace::LATE_FIRE : TimerTrace::FIRE, now, (uint32_t)(uintptr_t)timer, lateness);
+            }
+#endif
+            timer->dispatch(timerFeed.fireInfo(batch[i].scheduled, timer));
+        }
+        fired += count;
 
         timerFeed.updateTickTime();
     }
 
+    timerFeed.deferTarget = false;
+    SEQUENCE_STEP();
     isTickOngoing = false;
 }
 
 void TimerArrayControl::registerAttachedTimer(Timer* timer){
 
     // if timer is already attached to a controller, do nothing
-    if (timer->running) return;
+    if (timer->running || !timerFeed.claimTimer(timer)) return;
 
     // get current time in ticks and add the requested delay to find the target time
     timer->target = COUNTER_MODULO(timer->_delay + timerFeed.cnt);
+    TRACE(ATTACH, timer, timer->_delay);
 
     // insert timer based on the target time
     timerFeed.insertTimer(timer);
 }
 
 void TimerArrayControl::registerDetachedTimer(Timer* timer){
+    if (timer->blocked) return; // a TimerBlock member is only detached by its block
+
+    timer->pending = false;
+
+    if (timer->cancelled){
+        // unlink the tombstone now, the timer may be destroyed or attached elsewhere after this
+        TRACE(DETACH, timer, 0);
+        timerFeed.removeTimer(timer);
+        return;
+    }
+
     if (!timer->running) return;
+    TRACE(DETACH, timer, 0);
     timerFeed.removeTimer(timer);
 }
 
+void TimerArrayControl::registerCancel(Timer* timer){
+    if (timer->blocked) return; // it is not in the feed, a tombstone would never be unlinked
+
+    timer->pending = false;
+
+    if (!timer->running) return;
+
+    TRACE(CANCEL, timer, 0);
+
+    // leave the timer in the feed, it is unlinked when reached by tick or by an insertion
+    timerFeed.countTimer(timer, -1);
+    timer->running = false;
+    timer->cancelled = true;
+    ++timerFeed.tombstones;
+
+    // keep the number of tombstones bounded
+    if (timerFeed.tombstones > MAX_TOMBSTONES){
+        if (!isTickOngoing) timerFeed.updateTime(); // fetch counter, the interrupt target may be updated
+        timerFeed.removeTombstones();
+    }
+}
+
 void TimerArrayControl::registerDelayChange(Timer* timer, uint32_t delay){
 
+    if (timer->blocked) return;
+
+    delay = toTimerTicks(delay);
+
     if (!timer->running) {
+        // a cancelled timer is unlinked before its period changes, it may be bucketed by the old one
+        timerFeed.claimTimer(timer);
         timer->_delay = delay;
         return;
     }
 
+    TRACE(DELAY_CHANGE, timer, delay);
+
+    // the new delay is counted from the last restart
+    timerFeed.applyRestart(timer);
+
     uint32_t target;
     
     if (elapsedTicks(timer) > delay){
@@ -267,8 +854,19 @@ void TimerArrayControl::registerDelayChange(Timer* timer, uint32_t delay){
         target = COUNTER_MODULO(timer->target + delay - timer->_delay);
     }
 
+    // a bucketed timer leaves its bucket with the old period
+    const bool bucketed = timer->bucketed;
+    if (bucketed) timerFeed.removeTimer(timer);
+
     timer->_delay = delay;
 
+    if (bucketed){
+        // insert to the feed or the bucket of the new period
+        timer->target = target;
+        timerFeed.insertTimer(timer);
+        return;
+    }
+
     // update the position of timer in the feed
     timerFeed.updateTimerTarget(timer, target);
 }
@@ -276,21 +874,118 @@ void TimerArrayControl::registerDelayChange(Timer* timer, uint32_t delay){
 void TimerArrayControl::registerAttachedTimerInSync(Timer* timer, Timer* reference){
 
     // won't reattach timer (if attached to this controller, it would be possible)
-    if (timer->running) return;
+    if (timer->running || !timerFeed.claimTimer(timer)) return;
+
+    // the reference's period started at its last restart
+    if (reference->running) timerFeed.applyRestart(reference);
 
     // TODO: negative calculation might be also needed, for more complicated cases
     // put start time in timer's target, find the next firing time with timer's delay
     timer->target = COUNTER_MODULO(reference->target - reference->_delay);
     timer->target = timerFeed.calculateNextFireInSync(timer->target, timer->_delay);
 
+    TRACE(ATTACH, timer, timer->_delay);
+
     // find fitting place for timer in string
     timerFeed.insertTimer(timer);
 }
 
+void TimerArrayControl::registerTimerTable(const TimerTableEntry* entries, uint16_t count){
+
+    // every timer is placed after the previous one, continuing the search from there
+    TimerLink* it = &timerFeed.root;
+    Timer* first = timerFeed.root.next;
+
+    for (uint16_t i = 0; i < count; ++i){
+        Timer* timer = entries[i].timer;
+        if (timer->running || !timerFeed.claimTimer(timer)) continue;
+
+        // an unordered table still works, only slower
+        if (i > 0 && entries[i].offset < entries[i - 1].offset) it = &timerFeed.root;
+
+        timer->target = COUNTER_MODULO(entries[i].offset + timerFeed.cnt);
+        TRACE(ATTACH, timer, entries[i].offset);
+
+        // bucketed timers are not placed in the feed
+        if (timer->_periodic && timerFeed.bucketCount){
+            timerFeed.insertTimer(timer);
+            continue;
+        }
+
+        it = timerFeed.findTimerInsertionLink(it, timer);
+        timerFeed.insertTimer(it, timer);
+        it = timer;
+    }
+
+    // cancelled timers unlinked from the front change the first timer without an insertion there
+    if (timerFeed.root.next != first) timerFeed.updateHeadTarget();
+}
+
+void TimerArrayControl::registerShift(uint32_t delta){
+
+    TRACE(SHIFT, nullptr, delta);
+
+    // the targets are not touched, the feed's time is turned back by moving the epoch
+    timerFeed.epoch = COUNTER_MODULO(timerFeed.epoch + delta);
+    timerFeed.cnt = COUNTER_MODULO(timerFeed.cnt - delta);
+    timerFeed.now = COUNTER_MODULO(timerFeed.now - delta);
+    timerFeed.updateHeadTarget();
+
+    // the programmed edges are postponed with their timers
+    timerFeed.shiftEdges(delta);
+}
+
+void TimerArrayControl::registerRetune(uint32_t fclk, uint32_t clkdiv){
+
+    const uint32_t prescaler = clkdiv > max_prescale ? max_prescale : clkdiv;
+
+    // new tick frequency per old one: (fclk/prescaler) / (_fclk/_prescaler)
+    uint64_t num = (uint64_t)fclk * _prescaler;
+    uint64_t den = (uint64_t)_fclk * prescaler;
+    for (uint64_t a = num, b = den; ; ){
+        if (!b){
+            num /= a;
+            den /= a;
+            break;
+        }
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+
+    const bool running = isRunning();
+
+    // no ticks pass during the conversion
+    if (running) timerFeed.htim->Instance->CR1 = timerFeed.htim->Instance->CR1 & ~TIM_CR1_CEN;
+    timerFeed.updateTime();
+    timerFeed.rescale(num, den);
+    timerFeed.rescaleEdges(num, den);
+
+    if (running || suspended){
+        // the update event loads the prescaler, but it clears the counter too
+        const uint32_t counter = __HAL_TIM_GET_COUNTER(timerFeed.htim);
+        __HAL_TIM_SET_PRESCALER(timerFeed.htim, prescaler - 1);
+        timerFeed.htim->Instance->EGR = TIM_EGR_UG;
+        __HAL_TIM_SET_COUNTER(timerFeed.htim, counter);
+        __HAL_TIM_CLEAR_FLAG(timerFeed.htim, TIM_FLAG_UPDATE);
+    }
+    timerFeed.htim->Init.Prescaler = prescaler - 1;
+
+    _fclk = fclk;
+    _clkdiv = clkdiv;
+    _prescaler = prescaler;
+
+    timerFeed.updateHeadTarget();
+    if (running) timerFeed.htim->Instance->CR1 = timerFeed.htim->Instance->CR1 | TIM_CR1_CEN;
+}
+
 void TimerArrayControl::registerManualFire(Timer* timer){
 
+    if (timer->blocked) return;
+
     // fire timer manually, even if it is not running
     // firing a periodic timer will start it
+    TRACE(MANUAL_FIRE, timer, 0);
     timer->fire();
     
     // if timer was running detach it, if it was periodic it will be immedietely reattached
@@ -303,6 +998,109 @@ void TimerArrayControl::registerManualFire(Timer* timer){
     }
 }
 
+void TimerArrayControl::registerOutputTimer(OutputCompareTimer* timer){
+
+    // channel 1 drives the controller, the timer can't be moved while running
+    if (timer->_channel == TARGET_CC_CHANNEL || timer->running || !timerFeed.claimTimer(timer)) return;
+
+    timer->control = this;
+    timer->_level = timer->edge == OutputCompareTimer::RESET;
+
+    // start from the level before the first edge, the compare value is as far as possible
+    TIM_OC_InitTypeDef oc_init = {};
+    oc_init.OCMode = timer->_level ? TIM_OCMODE_FORCED_ACTIVE : TIM_OCMODE_FORCED_INACTIVE;
+    oc_init.Pulse = COUNTER_MODULO(timerFeed.cnt - 1 + timerFeed.epoch);
+    oc_init.OCPolarity = TIM_OCPOLARITY_HIGH;
+    oc_init.OCFastMode = TIM_OCFAST_DISABLE;
+    HAL_TIM_OC_ConfigChannel(timerFeed.htim, &oc_init, timer->_channel);
+    HAL_TIM_OC_Start(timerFeed.htim, timer->_channel);
+    timerFeed.outputChannels |= 1u << (timer->_channel >> 2);
+
+    registerAttachedTimer(timer);
+}
+
+void TimerArrayControl::registerAttachedAt(Timer* timer, uint32_t target){
+
+    if (timer->running || !timerFeed.claimTimer(timer)) return;
+
+    timer->target = COUNTER_MODULO(target);
+    TRACE(ATTACH, timer, COUNTER_MODULO(target - timerFeed.cnt));
+
+    if (COUNTER_MODULO(timerFeed.cnt - timer->target) >= CALLBACK_JITTER){
+        timerFeed.insertTimer(timer);
+        return;
+    }
+
+    // the target already passed, it would be sorted as the latest one, put it to the front instead
+    timerFeed.insertTimer(&timerFeed.root, timer);
+
+    // the compare match of the passed target will not come, run tick by software
+    if (!isTickOngoing) __HAL_GENERATE_INTERRUPT(timerFeed.htim, TIM_EGR_CC1G);
+}
+
+TimerHandle TimerArrayControl::registerAfter(uint32_t delay, PooledTimer::pooled_callback_function f, void* ctx){
+
+    // without a pool or free node the request can't be served, return an invalid handle
+    if (!timerPool) return TimerHandle();
+    PooledTimer* timer = timerPool->allocate();
+    if (!timer) return TimerHandle();
+
+    timer->callback = f;
+    timer->ctx = ctx;
+    timer->_delay = toTimerTicks(delay);
+    timer->_periodic = false;
+
+    registerAttachedTimer(timer);
+
+    return TimerHandle(timerPool, (uint16_t)(timer - timerPool->nodes), timer->generation);
+}
+
+bool TimerArrayControl::cancelPooledTimer(PooledTimer* timer, uint16_t generation){
+
+    bool cancelled = false;
+
+    if (!isTickOngoing) BEGIN_UPDATE();
+
+    // the node may have fired and been reused since the handle was made, the generation tells
+    if (timer->generation == generation && timer->isPending()){
+        TRACE(DETACH, timer, 0);
+        if (timer->running) timerFeed.removeTimer(timer);
+        timer->pending = false;
+        timerPool->release(timer);
+        cancelled = true;
+    }
+
+    if (!isTickOngoing) END_UPDATE();
+
+    return cancelled;
+}
+
+void TimerArrayControl::registerRestart(Timer* timer){
+
+    if (timer->blocked) return;
+
+    if (!timer->running){
+        registerAttachedTimer(timer);
+        return;
+    }
+
+    TRACE(RESTART, timer, timer->_delay);
+
+    const uint32_t deadline = COUNTER_MODULO(timer->_delay + timerFeed.cnt);
+
+    // a target placed further than the delay, by attachAt or a timer table offset, comes later than the new deadline,
+    // the timer is moved now, it would wait for the stale target otherwise
+    if (timerFeed.isSooner(deadline, timer->target)){
+        timer->restarted = false;
+        timerFeed.updateTimerTarget(timer, deadline);
+        return;
+    }
+
+    // only note the later deadline, the timer is moved when it reaches the head of the feed
+    timer->deadline = deadline;
+    timer->restarted = true;
+}
+
 
 //
 // Public members
@@ -314,10 +1112,10 @@ void TimerArrayControl::attachTimer(Timer* timer){
     if (!isTickOngoing){
         // timer is running and this is not on interrupt thread, use interrupt safe attach
         
-        DISABLE_INTERRUPT();
+        BEGIN_UPDATE();
         timerFeed.updateTime(); // fetch counter
         registerAttachedTimer(timer);
-        ENABLE_INTERRUPT();
+        END_UPDATE();
 
     } else {
         // timer is not running or this is an interrupt handler, attach is safe
@@ -332,9 +1130,9 @@ void TimerArrayControl::detachTimer(Timer* timer){
     if (!isTickOngoing){
         // timer is running and this is not on interrupt thread, use interrupt safe attach
         
-        DISABLE_INTERRUPT();
+        BEGIN_UPDATE();
         registerDetachedTimer(timer);
-        ENABLE_INTERRUPT();
+        END_UPDATE();
 
     } else {
         // timer is not running or this is an interrupt handler, attach is safe
@@ -348,10 +1146,10 @@ void TimerArrayControl::changeTimerDelay(Timer* timer, uint32_t delay){
     if (!isTickOngoing){
         // timer is running and this is not on interrupt thread, use interrupt safe attach
         
-        DISABLE_INTERRUPT();
+        BEGIN_UPDATE();
         timerFeed.updateTime(); // fetch counter
         registerDelayChange(timer, delay);
-        ENABLE_INTERRUPT();
+        END_UPDATE();
 
     } else {
         // timer is not running or this is an interrupt handler, attach is safe
@@ -359,15 +1157,88 @@ void TimerArrayControl::changeTimerDelay(Timer* timer, uint32_t delay){
     }
 }
 
+void TimerArrayControl::attachOutputTimer(OutputCompareTimer* timer){
+
+    if (!isTickOngoing){
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        registerOutputTimer(timer);
+        END_UPDATE();
+    } else registerOutputTimer(timer);
+}
+
+void TimerArrayControl::attachAt(Timer* timer, uint32_t target){
+
+    if (!isTickOngoing){
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        registerAttachedAt(timer, target);
+        END_UPDATE();
+    } else registerAttachedAt(timer, target);
+}
+
+void TimerArrayControl::attachCapture(TimerCapture* capture, uint32_t channel, uint32_t polarity){
+
+    // channel 1 drives the controller
+    if (channel == TARGET_CC_CHANNEL) return;
+
+    capture->channel = channel;
+    capture->control = this;
+    timerFeed.outputChannels &= ~(1u << (channel >> 2)); // not an output anymore, shifts leave it alone
+
+    TIM_IC_InitTypeDef ic_init = {};
+    ic_init.ICPolarity = polarity;
+    ic_init.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    ic_init.ICPrescaler = TIM_ICPSC_DIV1;
+    ic_init.ICFilter = 0;
+    HAL_TIM_IC_ConfigChannel(timerFeed.htim, &ic_init, channel);
+    HAL_TIM_IC_Start_IT(timerFeed.htim, channel);
+}
+
+void TimerArrayControl::detachCapture(TimerCapture* capture){
+    if (!capture->control) return;
+    HAL_TIM_IC_Stop_IT(timerFeed.htim, capture->channel);
+    capture->control = nullptr;
+}
+
+void TimerArrayControl::shiftAll(uint32_t delta){
+
+    if (!isTickOngoing){
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        registerShift(delta);
+        END_UPDATE();
+    } else registerShift(delta);
+}
+
+void TimerArrayControl::retune(uint32_t fclk, uint32_t clkdiv){
+
+    if (!isTickOngoing){
+        BEGIN_UPDATE();
+        registerRetune(fclk, clkdiv);
+        END_UPDATE();
+    } else registerRetune(fclk, clkdiv);
+}
+
+void TimerArrayControl::attachTimerTable(const TimerTableEntry* entries, uint16_t count){
+
+    if (!isTickOngoing){
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        registerTimerTable(entries, count);
+        END_UPDATE();
+    } else registerTimerTable(entries, count);
+}
+
 void TimerArrayControl::attachTimerInSync(Timer* timer, Timer* reference){
     
     if (!isTickOngoing){
         // timer is running and this is not on interrupt thread, use interrupt safe attach
         
-        DISABLE_INTERRUPT();
+        BEGIN_UPDATE();
         timerFeed.updateTime(); // fetch counter
         registerAttachedTimerInSync(timer, reference);
-        ENABLE_INTERRUPT();
+        END_UPDATE();
 
     } else {
         // timer is not running or this is an interrupt handler, attach is safe
@@ -380,10 +1251,10 @@ void TimerArrayControl::manualFire(Timer* timer){
     if (!isTickOngoing){
         // timer is running and this is not on interrupt thread, use interrupt safe attach
         
-        DISABLE_INTERRUPT();
+        BEGIN_UPDATE();
         timerFeed.updateTime(); // fetch counter
         registerManualFire(timer);
-        ENABLE_INTERRUPT();
+        END_UPDATE();
 
     } else {
         // timer is not running or this is an interrupt handler, attach is safe
@@ -391,6 +1262,69 @@ void TimerArrayControl::manualFire(Timer* timer){
     }
 }
 
+void TimerArrayControl::cancelTimer(Timer* timer){
+
+    if (!isTickOngoing){
+        // timer is running and this is not on interrupt thread, use interrupt safe cancel
+        
+        BEGIN_UPDATE();
+        registerCancel(timer);
+        END_UPDATE();
+
+    } else {
+        // timer is not running or this is an interrupt handler, cancel is safe
+        registerCancel(timer);
+    }
+}
+
+void TimerArrayControl::restartTimer(Timer* timer){
+    
+    if (!isTickOngoing){
+        // timer is running and this is not on interrupt thread, use interrupt safe restart
+        
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        registerRestart(timer);
+        END_UPDATE();
+
+    } else {
+        // timer is not running or this is an interrupt handler, restart is safe
+        registerRestart(timer);
+    }
+}
+
+void TimerArrayControl::usePeriodBuckets(TimerBucket* buckets, uint8_t count){
+    for (uint8_t i = 0; i < count; ++i) buckets[i].control = this;
+    timerFeed.buckets = buckets;
+    timerFeed.bucketCount = count;
+}
+
+void TimerArrayControl::setTimerPool(TimerPool* pool){
+    if (timerPool) timerPool->control = nullptr;
+    timerPool = pool;
+    if (timerPool) timerPool->control = this;
+}
+
+TimerHandle TimerArrayControl::after(uint32_t delay, PooledTimer::pooled_callback_function f, void* ctx){
+
+    TimerHandle handle;
+
+    if (!isTickOngoing){
+        // timer is running and this is not on interrupt thread, use interrupt safe attach
+        
+        BEGIN_UPDATE();
+        timerFeed.updateTime(); // fetch counter
+        handle = registerAfter(delay, f, ctx);
+        END_UPDATE();
+
+    } else {
+        // timer is not running or this is an interrupt handler, attach is safe
+        handle = registerAfter(delay, f, ctx);
+    }
+
+    return handle;
+}
+
 void TimerArrayControl::disableInterrupt(){
     DISABLE_INTERRUPT();
 }
@@ -423,18 +1357,165 @@ void TimerArrayControl::sleep(uint32_t ticks) const{
 }
 
 
+#ifdef TIMERARRAY_TRACE
+uint32_t TimerArrayControl::dumpTrace(void* out, uint32_t size) const {
+    if (size < sizeof(TimerTraceHeader)) return 0;
+
+    const TimerTrace& trace = timerFeed.trace;
+    uint32_t max = (size - sizeof(TimerTraceHeader)) / sizeof(TimerTraceEvent);
+
+    TimerTraceHeader* header = (TimerTraceHeader*)out;
+    header->magic = TimerTrace::magic;
+    header->version = TimerTrace::version;
+    header->bits = timerFeed.bits;
+    header->reserved = 0;
+    header->tick_frequency = (uint32_t)(actualTickFrequency() + 0.5f);
+    header->count = trace.copy((TimerTraceEvent*)(header + 1), max);
+
+    return sizeof(TimerTraceHeader) + header->count * sizeof(TimerTraceEvent);
+}
+
+TimerTrace& TimerArrayControl::trace(){
+    return timerFeed.trace;
+}
+#endif
+
+bool TimerArrayControl::nextDeadline(uint32_t& target){
+    bool found;
+    if (!isTickOngoing){
+        DISABLE_INTERRUPT();
+        timerFeed.updateTime(); // fetch counter
+        found = timerFeed.nextDeadline(target);
+        ENABLE_INTERRUPT();
+    } else found = timerFeed.nextDeadline(target);
+    return found;
+}
+
+uint16_t TimerArrayControl::periodicLoads(TimerLoad* loads, uint16_t max){
+    uint16_t count = 0;
+
+    if (!isTickOngoing){
+        DISABLE_INTERRUPT();
+        timerFeed.updateTime(); // fetch counter
+    }
+
+    for (const Timer* it = timerFeed.root.next; it; it = it->next){
+        // a bucket in the feed stands for its timers
+        if (it->container) continue;
+        timerFeed.addLoad(it, loads, max, count);
+    }
+    for (uint8_t i = 0; i < timerFeed.bucketCount; ++i){
+        for (const Timer* it = timerFeed.buckets[i].head; it; it = it->next) timerFeed.addLoad(it, loads, max, count);
+    }
+
+    if (!isTickOngoing) ENABLE_INTERRUPT();
+
+    return count;
+}
+
+uint32_t TimerArrayControl::ticksUntilNext(){
+    uint32_t target;
+    if (!nextDeadline(target)) return timerFeed.max_count;
+
+    // a due timer is waiting for the interrupt
+    if (COUNTER_MODULO(timerFeed.cnt - target) < CALLBACK_JITTER) return 0;
+    return COUNTER_MODULO(target - timerFeed.cnt);
+}
+
+void TimerArrayControl::setIdleHook(idle_hook_function hook, void* ctx, uint32_t wakeupLatency){
+    CriticalSection cs;
+    idleHook = hook;
+    idleContext = ctx;
+    this->wakeupLatency = wakeupLatency;
+}
+
+bool TimerArrayControl::idle(){
+    if (!idleHook || !isRunning()) return false;
+
+    // an interrupt between the query and the hook could leave the CPU asleep past the next timer,
+    // with interrupts masked it stays pending and wakes up the core
+    CriticalSection cs;
+    uint32_t ticks = ticksUntilNext();
+    if (ticks <= wakeupLatency) return false;
+
+    idleHook(ticks - wakeupLatency, idleContext);
+    return true;
+}
+
+void TimerArrayControl::setTickBudget(uint16_t callbacks, uint32_t ticks){
+    DISABLE_INTERRUPT();
+    budgetCallbacks = callbacks;
+    budgetTicks = ticks;
+    ENABLE_INTERRUPT();
+}
+
+uint32_t TimerArrayControl::tickSlices() const {
+    return slices;
+}
+
+uint16_t TimerArrayControl::attachedTimers() const {
+    return timerFeed.timerCount;
+}
+
 uint32_t TimerArrayControl::remainingTicks(Timer* timer) const {
-    if (!timer->running) return 0;
-    const uint32_t cnt = __HAL_TIM_GET_COUNTER(timerFeed.htim);
-    return COUNTER_MODULO(timer->target - cnt);
+    TimerSnapshot snapshot = {timer, false, 0, 0};
+    this->snapshot(&snapshot, 1);
+    return snapshot.remaining;
 }
 
 uint32_t TimerArrayControl::elapsedTicks(Timer* timer) const {
-    if (!timer->running) return 0;
-    return timer->_delay - remainingTicks(timer);
+    TimerSnapshot snapshot = {timer, false, 0, 0};
+    this->snapshot(&snapshot, 1);
+    return snapshot.elapsed;
+}
+
+void TimerArrayControl::snapshot(TimerSnapshot* timers, uint16_t count) const {
+    uint32_t sequence;
+    do {
+        // a tick between the reads changes the sequence, the reads are repeated then
+        sequence = timerFeed.sequence;
+        __DMB();
+
+        const uint32_t cnt = timerFeed.time();
+        for (uint16_t i = 0; i < count; ++i){
+            const Timer* timer = timers[i].timer;
+            timers[i].running = timer->running;
+            if (!timers[i].running){
+                timers[i].remaining = 0;
+                timers[i].elapsed = 0;
+                continue;
+            }
+            const uint32_t target = timer->restarted ? timer->deadline : timer->target;
+            timers[i].remaining = COUNTER_MODULO(target - cnt);
+            // a target placed by attachAt or a timer table can be further than the delay
+            timers[i].elapsed = timers[i].remaining < timer->_delay ? timer->_delay - timers[i].remaining : 0;
+        }
+
+        __DMB();
+    } while (sequence != timerFeed.sequence);
 }
 
 float TimerArrayControl::actualTickFrequency() const {
-    return ((float)fclk)/prescaler;
+    return ((float)_fclk)/_prescaler;
+}
+
+uint32_t TimerArrayControl::fclk() const {
+    return _fclk;
+}
+
+uint32_t TimerArrayControl::clkdiv() const {
+    return _clkdiv;
+}
+
+uint32_t TimerArrayControl::prescaler() const {
+    return _prescaler;
+}
+
+uint32_t TimerArrayControl::counter() const {
+    return timerFeed.time();
+}
+
+uint32_t TimerArrayControl::maxCount() const {
+    return timerFeed.max_count;
 }
 
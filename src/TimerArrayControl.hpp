@@ -8,12 +8,33 @@
 
 #include "CallbackChain.hpp"
 #include "Timer.hpp"
+#include "TimerPool.hpp"
+#include "TimerBucket.hpp"
+#include "OutputCompareTimer.hpp"
+#include "TimerTable.hpp"
+#include "TimerAnalyzer.hpp"
+#include "TimerTrace.hpp"
 
 
 // Callback chain setup for HAL_TIM_OC_DelayElapsedCallback function
 struct TIM_OC_DelayElapsed_CallbackChainID{};
 using TIM_OC_DelayElapsed_CallbackChain = CallbackChain<TIM_OC_DelayElapsed_CallbackChainID, TIM_HandleTypeDef*>;
 
+// State of a timer at the moment of a TimerArrayControl::snapshot, in ticks.
+struct TimerSnapshot{
+    const Timer* timer; // set by the caller
+    bool running;
+    uint32_t remaining;
+    uint32_t elapsed;
+};
+
+// edge timestamping on the spare channels, defined in TimerCapture.hpp
+class TimerCapture;
+
+// coroutine support types, defined in TimerCoroutine.hpp
+class TimerDelayAwaitable;
+class TimerExecutor;
+
 
 // Implements timer controller for hardware handling,
 // it encapsulates any hardware related issue and presents a simple common API.
@@ -23,52 +44,175 @@ using TIM_OC_DelayElapsed_CallbackChain = CallbackChain<TIM_OC_DelayElapsed_Call
 // fclk: timer's input clock speed, will be divided by clkdiv
 // clkdiv: how much clock division is required, maximum allowed value depends on the specific timer's prescale register's size
 //         currently limited for every timer to 65536 (16 bit prescale register), it could become a setting if needed
-// bits: the number of bits in the counter register (16 or 32)
+// bits: the number of bits in the counter register (16 or 32), limited to TIMERARRAY_TICK_BITS,
+//       a 32 bit timer then counts only to 65535, maxCount() returns the range in use
 // prescaler: minimum of 65536 and clkdiv, compare with clkdiv to find out if selected prescale is possible
 // fcnt: the actual counting frequency based on the settings and limitations
 class TimerArrayControl : TIM_OC_DelayElapsed_CallbackChain{
 public:
+    // called by idle with the ticks the CPU may sleep, already shortened by the wake-up latency
+    using idle_hook_function = void(*)(uint32_t ticks, void* ctx);
+
     TimerArrayControl(TIM_HandleTypeDef *const htim, const uint32_t fclk=F_CPU, const uint32_t clkdiv=F_CPU/10000, const uint8_t bits=16);
 
     void begin(); // start interrupt generation for the listeners
     void stop(); // halt the hardware timer, stop interrupt generation
+    void suspend(); // freeze the counter in O(1), the timers keep their remaining ticks
+    void resume(); // continue counting after suspend
+    void shiftAll(uint32_t delta); // postpone every timer and output compare edge by delta ticks in O(1), remaining ticks plus delta must fit the counter
+
+    // Change the input clock and division, e.g. after scaling the system clock.
+    // The remaining ticks and delays of the timers are converted to the new tick frequency, so the deadlines
+    // and the phases of periodic timers are kept (rounded to the new ticks, limited by the counter's range).
+    // The edges programmed by output compare timers are converted too, their leads stay in ticks.
+    // Timestamps already captured by a TimerCapture stay in the old ticks, read them before.
+    // The counter is stopped for the conversion and the prescaler is loaded by an update event.
+    void retune(uint32_t fclk, uint32_t clkdiv);
     void attachTimer(Timer* timer); // add a timer to the array, when it fires, the callback function is called
     void detachTimer(Timer* timer); // remove a timer from the array, stopping the callback event
     void changeTimerDelay(Timer* timer, uint32_t delay); // change the delay of the timer, fire if necessary (ruining synchrony)
     void attachTimerInSync(Timer* timer, Timer* reference); // add timer to the array, like it was attached the same time as the reference timer
+
+    // Attach every timer of a table in a single pass over the feed, instead of a sorted insert each.
+    // The entries must be ordered by offset, makeTimerTable sorts them at compile time.
+    void attachTimerTable(const TimerTableEntry* entries, uint16_t count);
+    template<uint16_t N>
+    void attachTimerTable(const TimerTable<N>& table){ attachTimerTable(table.entries, N); }
     void manualFire(Timer* timer);
+    // Stop the timer in O(1), it stays linked in the array until it is unlinked lazily.
+    // Until then it can only be attached to this controller again. Detach it to unlink it at once,
+    // before it is destroyed or attached to another controller.
+    void cancelTimer(Timer* timer);
+    void restartTimer(Timer* timer); // restart the timer's delay from now, in O(1) unless it was placed further than its delay, attach it if it is not running
+    void attachOutputTimer(OutputCompareTimer* timer); // set up the timer's channel for hardware edges, then attach it
+    void attachAt(Timer* timer, uint32_t target); // add timer to fire at the given time of the controller, e.g. a captured edge plus an offset
+
+    // Timestamp the edges on a spare channel (2-4) of the timer, the pin has to be set up for the timer's alternate function.
+    // polarity: TIM_ICPOLARITY_RISING, TIM_ICPOLARITY_FALLING or TIM_ICPOLARITY_BOTHEDGE
+    void attachCapture(TimerCapture* capture, uint32_t channel, uint32_t polarity=TIM_ICPOLARITY_RISING);
+    void detachCapture(TimerCapture* capture);
+
+    // Group periodic timers with equal delays into FIFO buckets, only the first timer of a bucket is in the feed.
+    // Every distinct period needs a bucket, timers without a free bucket are handled as usual.
+    // Call it before attaching any timer.
+    void usePeriodBuckets(TimerBucket* buckets, uint8_t count);
+
+    void setTimerPool(TimerPool* pool); // pool for the one-shot timers of the after function
+    TimerHandle after(uint32_t delay, PooledTimer::pooled_callback_function f, void* ctx=nullptr); // call f(ctx) once after delay ticks, using a timer from the pool
 
     void disableInterrupt();
     void enableInterrupt();
 
+    // Limit the work of a single interrupt to a number of callbacks and/or counter ticks, 0 means no limit.
+    // With due timers left, the interrupt is pended by software and the controller returns,
+    // so other interrupts of the same priority are served between the slices.
+    void setTickBudget(uint16_t callbacks, uint32_t ticks=0);
+    uint32_t tickSlices() const; // number of times the budget cut an interrupt short
+
     void sleep(uint32_t ticks) const; // waits for the given amount of ticks to pass
 
+    // Counter value when the first pending timer fires, false if no timer is pending.
+    // Never later than the real deadline, a bucket may report its cancelled first timer.
+    bool nextDeadline(uint32_t& target);
+    uint32_t ticksUntilNext(); // 0 if a timer is due, the full counter range if none is pending
+
+    // Low-power waiting in the main loop: idle calls the hook with the ticks until the next timer
+    // minus wakeupLatency, so a STOP mode wake-up source can be set to return in time.
+    // The hook runs with interrupts masked, WFI still wakes up on a pending interrupt,
+    // which is served when idle returns.
+    void setIdleHook(idle_hook_function hook, void* ctx=nullptr, uint32_t wakeupLatency=0);
+    bool idle(); // false if no hook is set or the next timer is closer than the wake-up latency
+
+    // Fill loads with the attached periodic timers for analyzeTimerLoad, the costs are left 0.
+    // Returns the number of periodic timers, only max of them are written.
+    uint16_t periodicLoads(TimerLoad* loads, uint16_t max);
+    static const uint32_t callback_jitter; // ticks a timer may be late and still be fired
+    TimerDelayAwaitable delay(uint32_t ticks, TimerExecutor* executor=nullptr); // co_await it in a TimerTask coroutine, resumed by executor or inline if none (C++20)
+
+#ifdef TIMERARRAY_TRACE
+    // write a TimerTraceHeader and the recorded events in chronological order to out,
+    // returns the number of bytes written, the trace is not cleared
+    uint32_t dumpTrace(void* out, uint32_t size) const;
+    TimerTrace& trace();
+#endif
+
+    uint16_t attachedTimers() const; // running timers, cancelled ones are not counted
     uint32_t remainingTicks(Timer* timer) const;
     uint32_t elapsedTicks(Timer* timer) const;
+
+    // Consistent state of many timers, counted from a single read of the counter.
+    // Interrupts are not masked, the reads are repeated if the controller's interrupt changed the timers meanwhile.
+    // Called from an interrupt, a modification of the timers that was interrupted is seen half done.
+    void snapshot(TimerSnapshot* timers, uint16_t count) const;
     float actualTickFrequency() const;
+    uint32_t counter() const; // current time of the controller, the hardware counter shifted back by shiftAll
+    uint32_t maxCount() const; // the counter wraps to 0 after this value
     bool isRunning() const;
 
+    uint32_t fclk() const;
+    uint32_t clkdiv() const;
+    uint32_t prescaler() const;
+
     static const uint8_t prescaler_bits = 16;
     static const auto max_prescale = (1 << prescaler_bits);
 
-    const uint32_t fclk;
-    const uint32_t clkdiv;
-    const uint32_t prescaler = clkdiv > max_prescale ? max_prescale : clkdiv;
-
 protected:
+    // changed only by retune
+    uint32_t _fclk;
+    uint32_t _clkdiv;
+    uint32_t _prescaler = _clkdiv > max_prescale ? max_prescale : _clkdiv;
+
     struct TimerFeed{
-        Timer root;
+        TimerLink root; // sentinel, root.next is the first timer to fire
         TIM_HandleTypeDef *const htim;
-        const uint8_t bits;
-        const uint32_t max_count = (1 << bits) - 1;
+        const uint8_t bits; // limited by the bits of timer_ticks_t
+        const uint32_t max_count = bits >= 32 ? 0xFFFFFFFF : ((uint32_t)1 << bits) - 1;
+        uint32_t epoch; // hardware counter value of the feed's time 0, targets and cnt are relative to it
+        volatile uint32_t sequence; // incremented before and after every modification, odd while modifying
+        void stepSequence(){ sequence = sequence + 1; } // a statement, C++20 deprecates using a volatile assignment's value
         uint32_t cnt; // current value of timer counter (saved to freeze while calculating)
+        uint32_t now; // counter value read by the last time update, cnt may be the interrupt target instead
+        uint16_t tombstones; // number of cancelled timers still linked in the feed
+        uint16_t timerCount; // running timers in the feed and the buckets, the buckets themselves are not counted
+        uint16_t prioritized; // running timers with a nonzero priority, without them the due timers are taken from the head
+        TimerBucket* buckets; // optional period buckets
+        uint8_t bucketCount;
+        uint8_t outputChannels; // bit (1 << channel/4) of every channel programmed by an OutputCompareTimer
+        bool deferTarget; // collect interrupt target changes instead of writing them
+        bool targetDirty; // the interrupt target changed while deferred
+#ifdef TIMERARRAY_TRACE
+        TimerTrace trace;
+#endif
 
         TimerFeed(TIM_HandleTypeDef *const htim, const uint8_t bits);
-        Timer* findTimerInsertionLink(Timer* it, Timer* timer);
-        void insertTimer(Timer* it, Timer* timer);
+        TimerLink* findTimerInsertionLink(TimerLink* it, Timer* timer);
+        void insertTimer(TimerLink* it, Timer* timer);
         void insertTimer(Timer* timer);
-        void removeTimer(Timer* timer);
+        bool removeTimer(Timer* timer); // false if the timer is not linked in this feed
+        bool claimTimer(Timer* timer); // unlink a cancelled timer before it is attached again, false if it was cancelled on another controller
+        void unlinkTimer(TimerLink* it, Timer* timer); // unlink timer that follows it
+        void removeTombstones(); // unlink every cancelled timer
+        void updateHeadTarget(); // set interrupt target for the first timer
+        uint32_t headTarget() const;
+        void setTarget(uint32_t target); // write the interrupt target, unless deferred
+        void commitTarget(); // write the deferred interrupt target
+        bool isHeadDue() const;
         void updateTimerTarget(Timer* timer, uint32_t target);
+        void applyRestart(Timer* timer); // move a lazily restarted timer to its real place
+        void releaseTimer(Timer* timer); // clear the state of a timer that left the feed
+        void countTimer(Timer* timer, int8_t change); // follow the number of running timers
+        TimerLink* highestDueLink(); // link before the first due timer of the highest priority, root if none is due
+
+        TimerBucket* findBucket(uint32_t delay, bool claim); // bucket serving the period, claim a free one if requested
+        void bucketInsert(TimerBucket* bucket, Timer* timer);
+        bool bucketRemove(TimerBucket* bucket, Timer* timer);
+        void bucketHeadChanged(TimerBucket* bucket, Timer* head); // follow the bucket's new first timer in the feed
+        void fireBucket(TimerBucket* bucket, const TimerFireInfo& info);
+
+        void scheduleEdge(OutputCompareTimer* timer, uint32_t time); // program the channel for an edge lead ticks after time
+        void setOutputMode(uint32_t channel, uint32_t mode);
+        void shiftEdges(uint32_t delta); // move the compare values of the output channels by delta ticks
+        void rescaleEdges(uint64_t num, uint64_t den); // convert the pending edges of the output channels like the timers
 
         // check if target comes sooner than reference if we are at cnt
         bool isSooner(uint32_t target, uint32_t reference);
@@ -78,19 +222,60 @@ protected:
 
         void updateTime();
         void updateTickTime();
+        uint32_t time() const; // the counter relative to the epoch
+
+        // timing of a firing dispatched at the current counter value
+        TimerFireInfo fireInfo(uint32_t scheduled, const Timer* timer) const;
+
+        bool nextDeadline(uint32_t& target) const; // first deadline of a running timer, relative to cnt
+        void addLoad(const Timer* timer, TimerLoad* loads, uint16_t max, uint16_t& count) const;
+
+        // convert the timers to a tick frequency num/den times the current one
+        void rescale(uint64_t num, uint64_t den);
+        void rescaleTimer(Timer* timer, uint64_t num, uint64_t den);
+        uint32_t rescaleTicks(uint32_t ticks, uint64_t num, uint64_t den) const;
+    };
+
+    struct DueTimer{
+        Timer* timer;
+        uint32_t scheduled; // target the timer was due at
     };
 
     void tick();
+    uint8_t collectDueTimers(DueTimer* batch, uint8_t max);
     void registerAttachedTimer(Timer* timer);
     void registerDetachedTimer(Timer* timer);
+    void registerCancel(Timer* timer);
     void registerDelayChange(Timer* timer, uint32_t delay);
     void registerAttachedTimerInSync(Timer* timer, Timer* reference);
+    void registerTimerTable(const TimerTableEntry* entries, uint16_t count);
     void registerManualFire(Timer* timer);
+    void registerRestart(Timer* timer);
+    void registerShift(uint32_t delta);
+    void registerRetune(uint32_t fclk, uint32_t clkdiv);
+    void registerOutputTimer(OutputCompareTimer* timer);
+    void registerAttachedAt(Timer* timer, uint32_t target);
+    TimerHandle registerAfter(uint32_t delay, PooledTimer::pooled_callback_function f, void* ctx);
+    bool cancelPooledTimer(PooledTimer* timer, uint16_t generation);
 
     void chainedCallback(TIM_HandleTypeDef*);
 
     TimerFeed timerFeed;
     volatile bool isTickOngoing;
+    TimerPool* timerPool;
+    bool suspended;
+    uint16_t budgetCallbacks; // callbacks allowed in one interrupt, 0 for no limit
+    uint32_t budgetTicks; // counter ticks allowed in one interrupt, 0 for no limit
+    uint32_t slices; // interrupts cut short by the budget
+    idle_hook_function idleHook;
+    void* idleContext;
+    uint32_t wakeupLatency;
+
+    friend class TimerPool;
+    friend class TimerBucket;
+    friend class OutputCompareTimer;
+    friend class TimerCapture;
+    friend class TwoStageControl;
 };
 
 
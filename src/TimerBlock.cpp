@@ -0,0 +1,203 @@
+#include "TimerBlock.hpp"
+#include "CriticalSection.hpp"
+
+// -----                           -----
+// ----- TimerBlock implementation -----
+// -----                           -----
+
+TimerBlock::TimerBlock(TimerArrayControl* control, uint32_t* offsets, Timer** timers, uint16_t capacity)
+    : Timer(0, true, nullptr), control(control), offsets(offsets), timers(timers), capacity(capacity), count(0), origin(0)
+{}
+
+bool TimerBlock::attachTimer(Timer* timer){
+    // the arrays are modified by the controller's interrupt, which can have any priority
+    CriticalSection cs;
+
+    // a member of this block stays, a timer running on the controller's feed is refused
+    if (timer->running) return timer->blocked && find(timer) != count;
+
+    // the tombstone of a cancelled timer is unlinked first, like any attach does,
+    // a timer cancelled on another controller is refused
+    if (timer->cancelled) control->detachTimer(timer);
+    if (timer->cancelled || count == capacity) return false;
+
+    const uint32_t now = control->counter();
+    if (!fits(now, timer->_delay)) rebase(now);
+    insert(timer, now + timer->_delay);
+    if (timers[first()] == timer) place();
+    return true;
+}
+
+void TimerBlock::detachTimer(Timer* timer){
+    CriticalSection cs;
+
+    if (!timer->running) return;
+
+    uint16_t index = find(timer);
+    if (index == count) return;
+
+    const bool wasFirst = index == first();
+    removeAt(index);
+    timer->running = false;
+    if (wasFirst) place();
+}
+
+uint32_t TimerBlock::remainingTicks(const Timer* timer) const {
+    if (!timer->running) return 0;
+    return control->maxCount() & (timer->target - control->counter());
+}
+
+uint16_t TimerBlock::size() const {
+    return count;
+}
+
+uint16_t TimerBlock::first() const {
+    return count - 1;
+}
+
+void TimerBlock::rebase(uint32_t time){
+    const uint32_t max = control->maxCount();
+    uint32_t delta = max & (time - origin);
+
+    // a due first member would get a negative offset, stop at its target
+    if (count && offsets[first()] < delta) delta = offsets[first()];
+    if (!delta) return;
+
+    for (uint16_t i = 0; i < count; ++i) offsets[i] -= delta;
+    origin = max & (origin + delta);
+}
+
+bool TimerBlock::fits(uint32_t time, uint32_t delay) const {
+    const uint32_t max = control->maxCount();
+    return (max & (time - origin)) <= max - delay;
+}
+
+uint16_t TimerBlock::dueCount(uint32_t elapsed) const {
+    // the due members are at the end, find the first one with a branch-free binary search
+    const uint32_t* base = offsets;
+    uint16_t n = count;
+    while (n > 1){
+        const uint16_t half = n / 2;
+        base = base[half] > elapsed ? base + half : base;
+        n -= half;
+    }
+    const uint16_t firstDue = (uint16_t)(base - offsets) + (n && *base > elapsed);
+    return count - firstDue;
+}
+
+uint16_t TimerBlock::find(const Timer* timer) const {
+    const uint32_t offset = control->maxCount() & (timer->target - origin);
+
+    // first entry with the timer's offset, then the equal offsets are checked one by one
+    uint16_t lo = 0, hi = count;
+    while (lo < hi){
+        uint16_t mid = (lo + hi) / 2;
+        if (offsets[mid] > offset) lo = mid + 1;
+        else hi = mid;
+    }
+    while (lo < count && offsets[lo] == offset && timers[lo] != timer) ++lo;
+    return (lo < count && timers[lo] == timer) ? lo : count;
+}
+
+void TimerBlock::insert(Timer* timer, uint32_t target){
+    const uint32_t max = control->maxCount();
+    const uint32_t offset = max & (target - origin);
+
+    // before the entries with equal offsets, they are taken from the end, so timers due together fire in attach order
+    uint16_t lo = 0, hi = count;
+    while (lo < hi){
+        uint16_t mid = (lo + hi) / 2;
+        if (offsets[mid] > offset) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (uint16_t i = count; i > lo; --i){
+        offsets[i] = offsets[i - 1];
+        timers[i] = timers[i - 1];
+    }
+    offsets[lo] = offset;
+    timers[lo] = timer;
+    ++count;
+
+    timer->target = max & target;
+    timer->running = true;
+    timer->blocked = true;
+}
+
+void TimerBlock::removeAt(uint16_t index){
+    timers[index]->blocked = false;
+    --count;
+    for (uint16_t i = index; i < count; ++i){
+        offsets[i] = offsets[i + 1];
+        timers[i] = timers[i + 1];
+    }
+}
+
+uint32_t TimerBlock::gap() const {
+    // the members due with the first one are skipped, a block without later members is parked far ahead
+    uint32_t ticks = count > 1 ? offsets[first() - 1] - offsets[first()] : 0;
+    if (!ticks){
+        const uint16_t due = dueCount(offsets[first()]);
+        ticks = due < count ? offsets[count - 1 - due] - offsets[first()] : control->maxCount() / 2;
+    }
+    return ticks < timer_ticks_max ? ticks : timer_ticks_max;
+}
+
+void TimerBlock::place(){
+    if (running) control->detachTimer(this);
+    if (!count) return;
+    _delay = gap();
+    control->attachAt(this, origin + offsets[first()]);
+}
+
+void TimerBlock::fire(){
+    TimerFireInfo info = {target, target, 0, 0};
+    dispatch(info);
+}
+
+void TimerBlock::dispatch(const TimerFireInfo&){
+    const uint32_t max = control->maxCount();
+
+    // the block's own timing is not used, a callback may have rebased the block to a later time
+    const uint32_t now = control->counter();
+
+    uint16_t due;
+    {
+        CriticalSection cs;
+        due = dueCount(max & (now - origin));
+    }
+
+    for (uint16_t i = 0; i < due; ++i){
+        Timer* timer;
+        TimerFireInfo info;
+        {
+            CriticalSection cs;
+
+            // a member may have been detached by a previous callback
+            if (!count || offsets[first()] > (max & (now - origin))) break;
+
+            // the last entry, no other entry moves
+            timer = timers[first()];
+            info.scheduled = max & (origin + offsets[first()]);
+            removeAt(first());
+
+            if (timer->_periodic){
+                if (!fits(info.scheduled, timer->_delay)) rebase(now);
+                insert(timer, info.scheduled + timer->_delay);
+            }
+            else timer->running = false;
+        }
+
+        info.now = control->counter(); // the previous callbacks took time
+        info.lateness = max & (info.now - info.scheduled);
+        info.missed = (timer->_periodic && timer->_delay) ? info.lateness / timer->_delay : 0;
+        timer->dispatch(info);
+    }
+
+    CriticalSection cs;
+
+    // the controller already moved the block by the gap to its next member, it only has to be placed again
+    // when the members changed since, or a late firing took more than the first ones
+    if (count && running && target == (max & (origin + offsets[first()]))) _delay = gap();
+    else place();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Timer.hpp"
+
+#include <cstdint>
+
+class TimerArrayControl;
+
+// Fixed capacity group of timers kept in contiguous sorted arrays instead of a linked list,
+// placed in the controller's feed as a single timer at the target of its first member.
+// The block is periodic in the feed with the gap to its next member as delay, so the controller
+// moves it on when it fires, and it only leaves the feed when its members change.
+// Insertion is a binary search, the members are kept in reverse order, so the due ones are
+// taken from the end without moving the others, and large timer sets don't chase pointers
+// across scattered objects. Targets are stored relative to an origin, which is only moved
+// when a new target would not fit the counter's range from it.
+// Attach, detach and query the members only through the block, the controller ignores
+// detachTimer, cancelTimer, changeTimerDelay, restartTimer and manualFire on them.
+// The members are not converted by TimerArrayControl::retune.
+class TimerBlock : public Timer{
+public:
+    bool attachTimer(Timer* timer); // delay is counted from now, false if the block is full or the timer runs on the controller
+    void detachTimer(Timer* timer);
+    uint32_t remainingTicks(const Timer* timer) const;
+    uint16_t size() const; // attached members
+
+protected:
+    TimerBlock(TimerArrayControl* control, uint32_t* offsets, Timer** timers, uint16_t capacity);
+
+    TimerArrayControl *const control;
+    uint32_t *const offsets; // targets relative to origin, descending, the first member to fire is the last entry
+    Timer **const timers; // members in the order of offsets
+    const uint16_t capacity;
+    uint16_t count;
+    uint32_t origin; // controller time the offsets are counted from, never after the first target
+
+    uint16_t first() const; // index of the member firing first, count must not be 0
+
+    void rebase(uint32_t time); // move origin towards time, keeping the offsets non-negative
+    bool fits(uint32_t time, uint32_t delay) const; // the offset of time plus delay is in the counter's range, no rebase is needed
+    uint16_t dueCount(uint32_t elapsed) const;
+    uint16_t find(const Timer* timer) const;
+    void insert(Timer* timer, uint32_t target);
+    void removeAt(uint16_t index);
+    uint32_t gap() const; // from the first member's target to the next later one, the block's re-arm delay
+    void place(); // put the block in the feed at its first member's target
+
+    virtual void fire();
+    virtual void dispatch(const TimerFireInfo& info);
+};
+
+// Timer block with statically allocated storage for N timers.
+template<uint16_t N>
+class StaticTimerBlock : public TimerBlock{
+public:
+    StaticTimerBlock(TimerArrayControl* control) : TimerBlock(control, offsetStorage, timerStorage, N) {}
+private:
+    uint32_t offsetStorage[N];
+    Timer* timerStorage[N];
+};
@@ -0,0 +1,25 @@
+#include "TimerBucket.hpp"
+#include "TimerArrayControl.hpp"
+
+// -----                            -----
+// ----- TimerBucket implementation -----
+// -----                            -----
+
+TimerBucket::TimerBucket()
+    : Timer(nullptr), head(nullptr), tail(nullptr), control(nullptr)
+{
+    container = true;
+}
+
+bool TimerBucket::isEmpty() const {
+    return head == nullptr;
+}
+
+void TimerBucket::fire(){
+    TimerFireInfo info = {target, target, 0, 0};
+    control->timerFeed.fireBucket(this, info);
+}
+
+void TimerBucket::dispatch(const TimerFireInfo& info){
+    control->timerFeed.fireBucket(this, info);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Timer.hpp"
+
+class TimerArrayControl;
+
+// FIFO of periodic timers sharing the same delay, used by TimerArrayControl::usePeriodBuckets.
+// Timers with equal periods keep their order forever, so only the first one of the bucket
+// is placed in the controller's feed, and a re-arm is a move to the end of the bucket.
+// Not meant to be attached by the user.
+class TimerBucket : public Timer{
+public:
+    TimerBucket();
+
+    bool isEmpty() const; // a bucket without timers is free to take any period
+
+protected:
+    Timer* head; // timer of the bucket that fires next
+    Timer* tail;
+    TimerArrayControl* control;
+
+    // fire the first timer of the bucket and put the bucket back in the feed
+    virtual void fire();
+    virtual void dispatch(const TimerFireInfo& info);
+
+    friend class TimerArrayControl;
+};
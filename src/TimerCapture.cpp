@@ -0,0 +1,55 @@
+#include "TimerCapture.hpp"
+
+#ifdef TIMERARRAY_CAPTURE
+// capture events of every timer go through the chain, like the compare events of the controllers
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim){
+    TIM_IC_Capture_CallbackChain::fire(htim);
+}
+#endif
+
+// -----                             -----
+// ----- TimerCapture implementation -----
+// -----                             -----
+
+TimerCapture::TimerCapture(uint32_t* buffer, uint16_t size)
+    : buffer(buffer), size(size), head(0), tail(0), dropped(0), control(nullptr), channel(0)
+{}
+
+bool TimerCapture::read(uint32_t& time){
+    uint16_t t = tail;
+    if (t == head) return false;
+
+    __DMB(); // the value was written before head
+    time = buffer[t];
+    __DMB();
+    tail = (t + 1) % size;
+    return true;
+}
+
+uint16_t TimerCapture::available() const{
+    uint16_t h = head;
+    uint16_t t = tail;
+    return h >= t ? h - t : size - t + h;
+}
+
+uint32_t TimerCapture::overruns() const{
+    return dropped;
+}
+
+void TimerCapture::chainedCallback(TIM_HandleTypeDef* htim){
+    // HAL tells the channel of the event as an active channel bit
+    if (!control || control->timerFeed.htim != htim || htim->Channel != (1u << (channel >> 2))) return;
+
+    uint32_t time = control->timerFeed.max_count & (HAL_TIM_ReadCapturedValue(htim, channel) - control->timerFeed.epoch);
+
+    uint16_t h = head;
+    uint16_t next = (h + 1) % size;
+    if (next == tail){
+        dropped = dropped + 1;
+        return;
+    }
+
+    buffer[h] = time;
+    __DMB();
+    head = next;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "TimerArrayControl.hpp"
+
+#include <cstdint>
+
+// Callback chain setup for HAL_TIM_IC_CaptureCallback function.
+// The library defines HAL_TIM_IC_CaptureCallback only if built with TIMERARRAY_CAPTURE,
+// otherwise call TIM_IC_Capture_CallbackChain::fire(htim) from your own definition.
+struct TIM_IC_Capture_CallbackChainID{};
+using TIM_IC_Capture_CallbackChain = CallbackChain<TIM_IC_Capture_CallbackChainID, TIM_HandleTypeDef*>;
+
+// Ring of edge timestamps captured by the hardware on a spare channel of a controller's timer.
+// The values are in the controller's time, like the targets of the timers,
+// so a timer can be attached relative to an edge with TimerArrayControl::attachAt.
+// The timestamps are not converted by TimerArrayControl::retune, read them before it.
+// Written from the capture interrupt and read from a single consumer without locking.
+// Attach it with TimerArrayControl::attachCapture.
+class TimerCapture : TIM_IC_Capture_CallbackChain{
+public:
+    bool read(uint32_t& time); // take the oldest timestamp, false if there is none
+    uint16_t available() const; // timestamps waiting to be read
+    uint32_t overruns() const; // edges lost because the ring was full
+
+protected:
+    TimerCapture(uint32_t* buffer, uint16_t size);
+
+    uint32_t *const buffer;
+    const uint16_t size; // one slot is kept free to tell a full ring from an empty one
+    volatile uint16_t head; // written by the interrupt
+    volatile uint16_t tail; // written by the reader
+    volatile uint32_t dropped;
+    TimerArrayControl* control;
+    uint32_t channel;
+
+    void chainedCallback(TIM_HandleTypeDef* htim);
+
+    friend class TimerArrayControl;
+};
+
+// Capture ring with statically allocated storage for N timestamps.
+template<uint16_t N>
+class StaticTimerCapture : public TimerCapture{
+public:
+    StaticTimerCapture() : TimerCapture(storage, N + 1) {}
+private:
+    uint32_t storage[N + 1];
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+// C++20 coroutine support, only available when the compiler implements coroutines.
+// Usage: co_await control.delay(ticks) inside a TimerTask coroutine.
+
+#include "TimerArrayControl.hpp"
+#include "CriticalSection.hpp"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+// Fixed block storage for coroutine frames, no heap is used.
+// Every frame takes a whole block, allocation fails if a frame is larger than a block.
+class CoroutineArena{
+public:
+    void* allocate(size_t size);
+    static void release(void* frame);
+
+    size_t blockSize() const { return _blockSize; }
+    size_t available() const { return _available; }
+
+protected:
+    CoroutineArena(unsigned char* storage, size_t blockSize, size_t blocks);
+
+    struct Block{
+        union{
+            CoroutineArena* arena; // owner of an allocated block
+            Block* next; // next free block
+        };
+        alignas(max_align_t) unsigned char frame[1];
+    };
+
+    const size_t _blockSize;
+    size_t _available;
+    Block* free;
+};
+
+// Arena with statically allocated storage for Blocks frames of FrameSize bytes each.
+template<size_t FrameSize, size_t Blocks>
+class StaticCoroutineArena : public CoroutineArena{
+public:
+    StaticCoroutineArena() : CoroutineArena(storage, block_size, Blocks) {}
+private:
+    static constexpr size_t block_size = (offsetof(Block, frame) + FrameSize + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+    alignas(max_align_t) unsigned char storage[block_size * Blocks];
+};
+
+// Return type of coroutines driven by timers.
+// The coroutine starts immedietely and frees its frame when it finishes.
+// The first parameter of the coroutine must be the CoroutineArena providing the frame,
+// it is only used by the frame allocation, leave it unnamed in the coroutine.
+//
+// TimerTask blink(CoroutineArena&, TimerArrayControl& control){
+//     while(1){ toggle(); co_await control.delay(5000); }
+// }
+class TimerTask{
+public:
+    struct promise_type{
+        template<typename ... Args>
+        static void* operator new(size_t size, CoroutineArena& arena, Args&...) noexcept {
+            return arena.allocate(size);
+        }
+        static void* operator new(size_t size) = delete; // frames never come from the heap
+        static void operator delete(void* frame) { CoroutineArena::release(frame); }
+        template<typename ... Args>
+        static void operator delete(void* frame, size_t, CoroutineArena&, Args&...) { CoroutineArena::release(frame); } // matches the placement new
+
+        static TimerTask get_return_object_on_allocation_failure() { return TimerTask(false); }
+        TimerTask get_return_object() { return TimerTask(true); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    bool isValid() const { return valid; } // false if the arena had no free block for the frame
+
+private:
+    explicit TimerTask(bool valid) : valid(valid) {}
+    bool valid;
+};
+
+class TimerDelayAwaitable;
+
+// Single threaded executor resuming coroutines in thread mode.
+// Timer expiries queue the waiting coroutines, call runPending from the main loop to resume them.
+class TimerExecutor{
+public:
+    TimerExecutor() : head(nullptr), tail(nullptr) {}
+
+    bool runPending(); // resume every queued coroutine, returns false if there was nothing to do
+    bool hasPending() const { return head != nullptr; }
+
+private:
+    void schedule(TimerDelayAwaitable* awaitable); // called from the timer interrupt
+
+    TimerDelayAwaitable* head;
+    TimerDelayAwaitable* tail;
+
+    friend class TimerDelayAwaitable;
+};
+
+// Awaitable returned by TimerArrayControl::delay.
+// Lives in the coroutine frame while suspended, so the timer needs no extra storage.
+// Without an executor the coroutine is resumed inline, inside the timer interrupt.
+class TimerDelayAwaitable{
+public:
+    TimerDelayAwaitable(TimerArrayControl& control, uint32_t ticks, TimerExecutor* executor)
+        : control(control), executor(executor), timer(ticks, false, this, expired), next(nullptr)
+    {}
+    ~TimerDelayAwaitable(){ control.detachTimer(&timer); } // a frame destroyed while waiting leaves no timer behind
+    TimerDelayAwaitable(const TimerDelayAwaitable&) = delete;
+    TimerDelayAwaitable& operator=(const TimerDelayAwaitable&) = delete;
+
+    bool await_ready() const noexcept { return timer.delay() == 0; }
+    void await_suspend(std::coroutine_handle<> h){
+        handle = h;
+        control.attachTimer(&timer);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    static void expired(TimerDelayAwaitable* awaitable){
+        if (awaitable->executor) awaitable->executor->schedule(awaitable);
+        else awaitable->handle.resume();
+    }
+
+    TimerArrayControl& control;
+    TimerExecutor *const executor;
+    ContextTimer<TimerDelayAwaitable> timer;
+    std::coroutine_handle<> handle;
+    TimerDelayAwaitable* next; // link in the executor's ready queue
+
+    friend class TimerExecutor;
+};
+
+// ----- Implementation -----
+
+inline CoroutineArena::CoroutineArena(unsigned char* storage, size_t blockSize, size_t blocks)
+    : _blockSize(blockSize), _available(blocks), free(nullptr)
+{
+    // chain the blocks in address order
+    for (size_t i = blocks; i > 0; --i){
+        Block* block = reinterpret_cast<Block*>(storage + (i-1)*blockSize);
+        block->next = free;
+        free = block;
+    }
+}
+
+inline void* CoroutineArena::allocate(size_t size){
+    if (offsetof(Block, frame) + size > _blockSize) return nullptr;
+
+    CriticalSection cs; // frames may be released from the timer interrupt
+    if (!free) return nullptr;
+    Block* block = free;
+    free = block->next;
+    --_available;
+    block->arena = this;
+    return block->frame;
+}
+
+inline void CoroutineArena::release(void* frame){
+    Block* block = reinterpret_cast<Block*>(static_cast<unsigned char*>(frame) - offsetof(Block, frame));
+    CoroutineArena* arena = block->arena;
+
+    CriticalSection cs;
+    block->next = arena->free;
+    arena->free = block;
+    ++arena->_available;
+}
+
+inline void TimerExecutor::schedule(TimerDelayAwaitable* awaitable){
+    CriticalSection cs;
+    awaitable->next = nullptr;
+    if (tail) tail->next = awaitable;
+    else head = awaitable;
+    tail = awaitable;
+}
+
+inline bool TimerExecutor::runPending(){
+    bool ran = false;
+    while(1){
+        TimerDelayAwaitable* awaitable;
+        {
+            CriticalSection cs;
+            awaitable = head;
+            if (!awaitable) break;
+            head = awaitable->next;
+            if (!head) tail = nullptr;
+        }
+
+        // the awaitable is destroyed when the coroutine continues, touch it no more
+        awaitable->handle.resume();
+        ran = true;
+    }
+    return ran;
+}
+
+inline TimerDelayAwaitable TimerArrayControl::delay(uint32_t ticks, TimerExecutor* executor){
+    return TimerDelayAwaitable(*this, ticks, executor);
+}
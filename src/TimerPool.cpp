@@ -0,0 +1,104 @@
+#include "TimerPool.hpp"
+#include "TimerArrayControl.hpp"
+
+// -----                            -----
+// ----- PooledTimer implementation -----
+// -----                            -----
+
+PooledTimer::PooledTimer()
+    : Timer(nullptr), callback(nullptr), ctx(nullptr), pool(nullptr), generation(0)
+{}
+
+bool PooledTimer::isPending() const {
+    return running || pending;
+}
+
+void PooledTimer::fire(){
+    pooled_callback_function cb = callback;
+    void* cb_ctx = ctx;
+
+    // the node is already unlinked from the feed, give it back before the callback
+    pool->release(this);
+
+    cb(cb_ctx);
+}
+
+// -----                            -----
+// ----- TimerHandle implementation -----
+// -----                            -----
+
+TimerHandle::TimerHandle() : pool(nullptr), index(0), generation(0) {}
+
+TimerHandle::TimerHandle(TimerPool* pool, uint16_t index, uint16_t generation)
+    : pool(pool), index(index), generation(generation)
+{}
+
+bool TimerHandle::isValid() const {
+    return pool != nullptr;
+}
+
+bool TimerHandle::isPending() const {
+    return pool && pool->isPending(index, generation);
+}
+
+bool TimerHandle::cancel(){
+    return pool && pool->cancel(index, generation);
+}
+
+// -----                          -----
+// ----- TimerPool implementation -----
+// -----                          -----
+
+TimerPool::TimerPool(PooledTimer* nodes, uint16_t capacity)
+    : nodes(nodes), _capacity(capacity), _available(0), free(nullptr), control(nullptr)
+{}
+
+void TimerPool::init(){
+    free = nullptr;
+    for (uint16_t i = _capacity; i > 0; --i){
+        PooledTimer* node = &nodes[i-1];
+        node->pool = this;
+        node->next = free;
+        free = node;
+    }
+    _available = _capacity;
+}
+
+uint16_t TimerPool::capacity() const {
+    return _capacity;
+}
+
+uint16_t TimerPool::available() const {
+    return _available;
+}
+
+PooledTimer* TimerPool::allocate(){
+    if (!free) return nullptr;
+
+    PooledTimer* node = static_cast<PooledTimer*>(free);
+    free = node->next;
+    node->next = nullptr;
+    --_available;
+    return node;
+}
+
+void TimerPool::release(PooledTimer* node){
+    // invalidate every handle referring to the previous use of the node
+    ++node->generation;
+    node->callback = nullptr;
+    node->ctx = nullptr;
+    node->next = free;
+    free = node;
+    ++_available;
+}
+
+bool TimerPool::cancel(uint16_t index, uint16_t generation){
+    if (!control || index >= _capacity) return false;
+    return control->cancelPooledTimer(&nodes[index], generation);
+}
+
+bool TimerPool::isPending(uint16_t index, uint16_t generation) const {
+    if (index >= _capacity) return false;
+    const PooledTimer& node = nodes[index];
+    return node.generation == generation && node.isPending();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Timer.hpp"
+
+#include <cstdint>
+
+class TimerPool;
+class TimerArrayControl;
+
+// One-shot timer node owned by a TimerPool.
+// Not meant to be used directly, TimerArrayControl::after hands them out.
+class PooledTimer : public Timer{
+public:
+    using pooled_callback_function = void(*)(void*);
+    PooledTimer();
+
+protected:
+    pooled_callback_function callback;
+    void* ctx;
+    TimerPool* pool;
+    uint16_t generation; // incremented every time the node returns to the pool
+
+    bool isPending() const; // attached, or collected by tick and not fired yet
+
+    // returns the node to the pool before calling the callback,
+    // so the callback can already reuse the slot
+    virtual void fire();
+
+    friend class TimerPool;
+    friend class TimerArrayControl;
+};
+
+// Reference to a pooled one-shot timer, returned by TimerArrayControl::after.
+// The generation counter makes the handle safe to use after the timer fired
+// or was cancelled, the node may be already reused by another request.
+class TimerHandle{
+public:
+    TimerHandle();
+
+    bool isValid() const; // false if the pool was exhausted or no pool was set
+    bool isPending() const; // the referenced timer did not fire and was not cancelled yet
+    bool cancel(); // stop the timer if still pending, returns true if it was stopped
+
+private:
+    TimerHandle(TimerPool* pool, uint16_t index, uint16_t generation);
+
+    TimerPool* pool;
+    uint16_t index;
+    uint16_t generation;
+
+    friend class TimerArrayControl;
+};
+
+// Fixed capacity storage of one-shot timers with O(1) allocation and release.
+// Nodes go back to the pool when they fire or get cancelled.
+// A pool serves a single TimerArrayControl, set it with setTimerPool.
+class TimerPool{
+public:
+    uint16_t capacity() const;
+    uint16_t available() const;
+
+protected:
+    TimerPool(PooledTimer* nodes, uint16_t capacity);
+    void init(); // build the free list, call after the nodes are constructed
+
+    PooledTimer* allocate();
+    void release(PooledTimer* node);
+    bool cancel(uint16_t index, uint16_t generation);
+    bool isPending(uint16_t index, uint16_t generation) const;
+
+    PooledTimer *const nodes;
+    const uint16_t _capacity;
+    uint16_t _available;
+    Timer* free; // free nodes are chained through their next pointer
+    TimerArrayControl* control;
+
+    friend class PooledTimer;
+    friend class TimerHandle;
+    friend class TimerArrayControl;
+};
+
+// Pool with statically allocated storage for N one-shot timers.
+template<uint16_t N>
+class StaticTimerPool : public TimerPool{
+public:
+    StaticTimerPool() : TimerPool(storage, N) {
+        init();
+    }
+private:
+    PooledTimer storage[N];
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Timer.hpp"
+
+#include <cstdint>
+
+// Descriptor of a timer attached at startup by TimerArrayControl::attachTimerTable.
+// timer: the timer to attach, its delay and periodicity are kept
+// offset: ticks from the attach until the first firing, the phase of a periodic timer
+struct TimerTableEntry{
+    Timer* timer;
+    timer_ticks_t offset;
+};
+
+// Timer descriptors ordered by offset, build it with makeTimerTable.
+// Declared constexpr, the table is placed in flash and attached in one pass.
+template<uint16_t N>
+struct TimerTable{
+    TimerTableEntry entries[N];
+
+    constexpr uint16_t size() const { return N; }
+};
+
+// Sort timer descriptors by their offsets at compile time, equal offsets keep their order.
+//
+// constexpr TimerTableEntry entries[] = {{&t_sensor, 20}, {&t_led, 0}, {&t_log, 5}};
+// constexpr auto table = makeTimerTable(entries);
+// control.attachTimerTable(table);
+template<uint16_t N>
+constexpr TimerTable<N> makeTimerTable(const TimerTableEntry (&entries)[N]){
+    TimerTable<N> table{};
+    for (uint16_t i = 0; i < N; ++i){
+        // insertion sort, the tables are short and it is stable
+        uint16_t j = i;
+        while (j > 0 && table.entries[j - 1].offset > entries[i].offset){
+            table.entries[j] = table.entries[j - 1];
+            --j;
+        }
+        table.entries[j] = entries[i];
+    }
+    return table;
+}
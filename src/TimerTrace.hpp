@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+// Compile time optional event recorder of TimerArrayControl.
+// Enable it by defining TIMERARRAY_TRACE for every translation unit (build flag: -D TIMERARRAY_TRACE).
+// TIMERARRAY_TRACE_SIZE sets the number of recorded events, must be a power of 2.
+// TIMERARRAY_TRACE_LATE sets the lateness in ticks above which a fire is recorded as late.
+// Dump the events with TimerArrayControl::dumpTrace and decode them on the host with tools/trace2chrome.py.
+
+#ifndef TIMERARRAY_TRACE_SIZE
+#define TIMERARRAY_TRACE_SIZE 256
+#endif
+
+#ifndef TIMERARRAY_TRACE_LATE
+#define TIMERARRAY_TRACE_LATE 2
+#endif
+
+// A single recorded event, 12 bytes, little endian in the dump.
+struct TimerTraceEvent{
+    uint32_t timestamp; // hardware counter value when the event was recorded
+    uint32_t ref; // address of the timer, or the written value for CCR writes
+    uint32_t info; // event type in the low 8 bits, event argument in the high 24 bits
+};
+
+// Header written before the events by dumpTrace, 16 bytes, little endian.
+struct TimerTraceHeader{
+    uint32_t magic; // TimerTrace::magic
+    uint16_t version;
+    uint8_t bits; // counter bits of the controller, needed to unwrap the timestamps
+    uint8_t reserved;
+    uint32_t tick_frequency; // counter ticks per second
+    uint32_t count; // number of events following the header
+};
+
+class TimerTrace{
+public:
+    enum EventType : uint8_t{
+        ATTACH = 1, // argument: delay
+        DETACH = 2,
+        CANCEL = 3,
+        RESTART = 4,
+        DELAY_CHANGE = 5, // argument: new delay
+        FIRE = 6, // argument: ticks elapsed since the target
+        LATE_FIRE = 7, // argument: ticks elapsed since the target
+        MANUAL_FIRE = 8,
+        CCR_WRITE = 9, // ref holds the written compare value
+        SHIFT = 10 // argument: ticks every timer was postponed by
+    };
+
+    static const uint32_t magic = 0x52544154; // "TATR"
+    static const uint16_t version = 1;
+    static const uint32_t size = TIMERARRAY_TRACE_SIZE;
+    static_assert((size & (size - 1)) == 0, "TIMERARRAY_TRACE_SIZE must be a power of 2");
+
+    TimerTrace() : head(0) {}
+
+    // store an event, overwriting the oldest one if the buffer is full
+    void record(EventType type, uint32_t timestamp, uint32_t ref, uint32_t arg){
+        TimerTraceEvent& event = events[head & (size - 1)];
+        event.timestamp = timestamp;
+        event.ref = ref;
+        event.info = type | (arg << 8);
+        ++head;
+    }
+
+    uint32_t count() const { return head < size ? head : size; } // number of events held
+    uint32_t recorded() const { return head; } // number of events since the last clear, including the overwritten ones
+    void clear() { head = 0; }
+
+    // copy the held events to out in chronological order, returns the number of copied events
+    uint32_t copy(TimerTraceEvent* out, uint32_t max) const {
+        uint32_t n = count() < max ? count() : max;
+        uint32_t first = head - n;
+        for (uint32_t i = 0; i < n; ++i) out[i] = events[(first + i) & (size - 1)];
+        return n;
+    }
+
+private:
+    TimerTraceEvent events[size];
+    uint32_t head; // index of the next event to write, not wrapped
+};
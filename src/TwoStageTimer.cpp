@@ -0,0 +1,152 @@
+#include "TwoStageTimer.hpp"
+#include "TimerArrayControl.hpp"
+
+// -----                              -----
+// ----- TwoStageTimer implementation -----
+// -----                              -----
+
+TwoStageTimer::TwoStageTimer(uint32_t delay, bool isPeriodic, const Timer::callback_function f)
+    : coarseStage(this, coarseFired), fineStage(this, fineFired), control(nullptr), f(f),
+    _delay(delay), _periodic(isPeriodic), running(false), hop(false), fineStart(0), coarseStart(0)
+{}
+
+bool TwoStageTimer::isRunning() const {
+    return running;
+}
+
+bool TwoStageTimer::isPeriodic() const {
+    return _periodic;
+}
+
+uint32_t TwoStageTimer::delay() const {
+    return _delay;
+}
+
+void TwoStageTimer::periodic(bool val){
+    if (running) return; // can't change parameters directly if running
+    _periodic = val;
+}
+
+void TwoStageTimer::delay(uint32_t val){
+    if (running) return; // can't change parameters directly if running
+    _delay = val;
+}
+
+void TwoStageTimer::coarseFired(TwoStageTimer* timer){
+    if (!timer->running) return; // detached while the stage was firing
+
+    // the rest of the delay is always short enough for the fine stage
+    timer->control->schedule(timer, false, timer->control->coarse);
+}
+
+void TwoStageTimer::fineFired(TwoStageTimer* timer, const TimerFireInfo& info){
+    if (!timer->running) return;
+
+    if (timer->hop){
+        // the coarse tick is over, the delay can continue on the coarse stage
+        timer->hop = false;
+        timer->control->schedule(timer, true, timer->control->fine);
+        return;
+    }
+
+    if (timer->_periodic){
+        // count the next period from the scheduled firing, the lateness is corrected by the fine counter
+        timer->fineStart = info.scheduled;
+        timer->coarseStart = timer->control->coarse->counter();
+        timer->control->schedule(timer, true, timer->control->fine);
+    } else {
+        timer->running = false;
+    }
+
+    timer->f();
+}
+
+
+// -----                                -----
+// ----- TwoStageControl implementation -----
+// -----                                -----
+
+TwoStageControl::TwoStageControl(TimerArrayControl* coarse, TimerArrayControl* fine, uint32_t margin) :
+    coarse(coarse),
+    fine(fine),
+    requestedMargin(margin)
+{
+    updateRates();
+}
+
+void TwoStageControl::updateRates(){
+    fineRate = (uint64_t)fine->fclk() * coarse->prescaler();
+    coarseRate = (uint64_t)coarse->fclk() * fine->prescaler();
+    margin = requestedMargin ? requestedMargin : (uint32_t)(2 * ((fineRate + coarseRate - 1) / coarseRate));
+}
+
+void TwoStageControl::attachTimer(TwoStageTimer* timer){
+    if (timer->running) return;
+
+    updateRates();
+    timer->control = this;
+    timer->running = true;
+    timer->hop = false;
+    timer->fineStart = fine->counter();
+    timer->coarseStart = coarse->counter();
+    schedule(timer, true, nullptr);
+}
+
+void TwoStageControl::detachTimer(TwoStageTimer* timer){
+    if (!timer->running) return;
+
+    // a coarse stage firing meanwhile does not hand the timer over anymore
+    timer->running = false;
+    coarse->detachTimer(&timer->coarseStage);
+    fine->detachTimer(&timer->fineStage);
+}
+
+uint32_t TwoStageControl::remainingTicks(TwoStageTimer* timer) const {
+    if (!timer->running) return 0;
+    uint32_t elapsed = elapsedTicks(timer);
+    return elapsed < timer->_delay ? timer->_delay - elapsed : 0;
+}
+
+uint32_t TwoStageControl::elapsedTicks(const TwoStageTimer* timer) const {
+    const uint32_t fineMax = fine->maxCount();
+    const uint32_t fineDelta = fineMax & (fine->counter() - timer->fineStart);
+    const uint32_t coarseDelta = coarse->maxCount() & (coarse->counter() - timer->coarseStart);
+
+    // the coarse counter tells the elapsed time with an error of about a coarse tick,
+    // the fine counter tells the exact low bits, take the nearest value matching them
+    const uint64_t estimate = coarseDelta * fineRate / coarseRate;
+    uint32_t correction = fineMax & (fineDelta - (uint32_t)estimate);
+    int64_t elapsed = (int64_t)estimate + correction;
+    if (correction > fineMax / 2) elapsed -= (int64_t)fineMax + 1;
+
+    return elapsed < 0 ? 0 : (uint32_t)elapsed;
+}
+
+void TwoStageControl::schedule(TwoStageTimer* timer, bool allowCoarse, const TimerArrayControl* caller){
+    uint32_t elapsed = elapsedTicks(timer);
+    uint32_t remaining = elapsed < timer->_delay ? timer->_delay - elapsed : 0;
+    const bool useFine = !allowCoarse || remaining <= margin;
+
+    // the feed of a controller whose tick was preempted must not be modified, use the other controller meanwhile
+    if (useFine && fine != caller && fine->isTickOngoing){
+        timer->coarseStage.delay(1); // retry the handover after the fine tick
+        coarse->attachTimer(&timer->coarseStage);
+        return;
+    }
+    if (!useFine && coarse != caller && coarse->isTickOngoing){
+        timer->hop = true;
+        timer->fineStage.delay(margin);
+        fine->attachTimer(&timer->fineStage);
+        return;
+    }
+
+    if (useFine){
+        timer->fineStage.delay(remaining);
+        fine->attachTimer(&timer->fineStage);
+        return;
+    }
+
+    // fire the coarse stage before the end of the delay, at least margin fine ticks earlier
+    timer->coarseStage.delay((uint32_t)((remaining - margin) * coarseRate / fineRate));
+    coarse->attachTimer(&timer->coarseStage);
+}
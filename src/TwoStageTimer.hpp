@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Timer.hpp"
+
+#include <cstdint>
+
+class TimerArrayControl;
+class TwoStageControl;
+
+// Timer with a long delay and the resolution of a fast counting controller, see TwoStageControl.
+// Attach it with TwoStageControl::attachTimer.
+//
+// delay: ticks of the fine controller until firing, limited by the range of the coarse controller
+// isPeriodic: does the timer restart immedietely when fires, the period does not drift
+// f: static function called when timer is firing, from the fine controller's interrupt
+class TwoStageTimer{
+public:
+    TwoStageTimer(uint32_t delay, bool isPeriodic, const Timer::callback_function f);
+
+    bool isRunning() const;
+    bool isPeriodic() const;
+    uint32_t delay() const;
+
+    void periodic(bool val);
+    void delay(uint32_t val);
+
+protected:
+    ContextTimer<TwoStageTimer> coarseStage; // covers the long part of the delay
+    ContextTimingTimer<TwoStageTimer> fineStage; // final approach on the fine controller
+    TwoStageControl* control;
+    const Timer::callback_function f;
+    uint32_t _delay; // in fine ticks
+    bool _periodic;
+    bool running;
+    bool hop; // the fine stage only bridges an ongoing coarse tick, the delay is rescheduled when it fires
+    uint32_t fineStart; // fine counter value the delay is counted from
+    uint32_t coarseStart; // coarse counter value read at the same time
+
+    static void coarseFired(TwoStageTimer* timer);
+    static void fineFired(TwoStageTimer* timer, const TimerFireInfo& info);
+
+    friend class TwoStageControl;
+};
+
+// Pairs a slow counting coarse controller with a fast counting fine one, so long delays
+// are not limited by the counter range of the fine controller. The coarse stage fires once
+// near the end of the delay and hands the timer over to the fine stage for the final approach,
+// no interrupts are needed in between.
+// The elapsed time is measured with the coarse counter and corrected with the low bits
+// read from the fine counter, so the coarse tick's phase does not cause an error.
+// Both controllers must be running, their interrupts may have different priorities.
+// A stage is never attached to a controller whose tick was preempted by the other one's interrupt,
+// the handover is postponed by a coarse tick, or a fine stage of margin ticks bridges the coarse tick.
+// Call attachTimer and detachTimer from the main loop or from interrupts that do not preempt the controllers.
+// The tick rates are read from the controllers at every attach, after a retune of either one
+// the running timers have to be detached and attached again.
+//
+// coarse: slow counting controller, its range limits the delays
+// fine: fast counting controller, its frequency should be an integer multiple of the coarse one
+// margin: fine ticks left for the fine stage, 0 selects two coarse ticks,
+//         with one more coarse tick it must stay below half of the fine counter's range
+class TwoStageControl{
+public:
+    TwoStageControl(TimerArrayControl* coarse, TimerArrayControl* fine, uint32_t margin=0);
+
+    void attachTimer(TwoStageTimer* timer); // delay is counted from now
+    void detachTimer(TwoStageTimer* timer);
+    uint32_t remainingTicks(TwoStageTimer* timer) const; // in fine ticks
+
+protected:
+    TimerArrayControl* const coarse;
+    TimerArrayControl* const fine;
+    uint64_t fineRate; // fine ticks per coarse tick is fineRate/coarseRate
+    uint64_t coarseRate;
+    const uint32_t requestedMargin; // 0 follows the coarse tick
+    uint32_t margin;
+
+    void updateRates(); // read the tick rates of the controllers, they may have been retuned
+
+    uint32_t elapsedTicks(const TwoStageTimer* timer) const; // fine ticks since the start of the delay
+    // attach the stage the remaining delay needs, caller is the controller whose tick calls it, if any
+    void schedule(TwoStageTimer* timer, bool allowCoarse, const TimerArrayControl* caller);
+
+    friend class TwoStageTimer;
+};
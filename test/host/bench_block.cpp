@@ -0,0 +1,79 @@
+// Linked feed against a TimerBlock at several sizes: attaching n one-shot timers with random delays,
+// then firing them all. The counter jumps to the next compare value, so the stepping of the simulated
+// counter is not measured.
+#include "sim.hpp"
+
+#include <chrono>
+#include <random>
+
+const uint32_t span = 20000; // delays are spread over this many ticks
+
+uint32_t fired = 0;
+void onFire(){ ++fired; }
+
+using Clock = std::chrono::steady_clock;
+double since(Clock::time_point start){
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Result{
+    double attach; // ns per timer
+    double fire;
+};
+
+// step the counter onto the compare values until every timer fired
+void fireAll(SimTimer& sim, uint32_t count){
+    while (fired < count){
+        sim.regs.CNT = sim.regs.CCR1 - 1;
+        sim.run(1);
+    }
+}
+
+template<uint16_t N>
+Result run(bool useBlock, const std::vector<uint32_t>& delays){
+    SimTimer sim(32);
+    TimerArrayControl control(&sim.htim, 10000, 1, 32);
+    StaticTimerBlock<N> block(&control);
+    std::vector<Timer> timers;
+    timers.reserve(N);
+    for (uint16_t i = 0; i < N; ++i) timers.emplace_back(delays[i], false, onFire);
+    control.begin();
+    fired = 0;
+
+    auto start = Clock::now();
+    for (Timer& timer : timers){
+        if (useBlock) block.attachTimer(&timer);
+        else control.attachTimer(&timer);
+    }
+    Result result;
+    result.attach = since(start) / N;
+
+    start = Clock::now();
+    fireAll(sim, N);
+    result.fire = since(start) / N;
+
+    return result;
+}
+
+template<uint16_t N>
+void compare(std::mt19937& rng){
+    std::uniform_int_distribution<uint32_t> delay(1, span);
+    std::vector<uint32_t> delays(N);
+    for (uint32_t& d : delays) d = delay(rng);
+
+    Result feed = run<N>(false, delays);
+    Result block = run<N>(true, delays);
+    printf("%6u %12.1f %12.1f %12.1f %12.1f\n", N, feed.attach, block.attach, feed.fire, block.fire);
+}
+
+int main(){
+    std::mt19937 rng(1);
+
+    printf("ns per timer  %13s %12s %12s %12s\n", "feed attach", "block attach", "feed fire", "block fire");
+    compare<16>(rng);
+    compare<64>(rng);
+    compare<256>(rng);
+    compare<1024>(rng);
+    compare<4096>(rng);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// RAM and cache footprint of the packed Timer node against the layout before it was packed:
+// node sizes, and the time of walking a feed of nodes scattered in memory.
+// On a 64 bit host the pointers dominate, the 4 byte Cortex-M sizes are listed in the README.
+#include "sim.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// the node layout before packing: full width fields in declaration order, the root was a full node
+class LegacyTimer{
+public:
+    LegacyTimer() : _delay(0), _periodic(false), target(0), f(nullptr), running(false), next(nullptr) {}
+    virtual ~LegacyTimer() {}
+    virtual void fire() {}
+    LegacyTimer* link() const { return next; }
+    void link(LegacyTimer* t){ next = t; }
+    uint32_t at() const { return target; }
+
+    uint32_t _delay;
+    bool _periodic;
+    uint32_t target;
+    void *const f;
+    bool running;
+    LegacyTimer* next;
+};
+
+void noop(){}
+
+// exposes the links of the packed node
+class PackedTimer : public Timer{
+public:
+    PackedTimer() : Timer(noop) {}
+    PackedTimer* link() const { return static_cast<PackedTimer*>(next); }
+    void link(PackedTimer* t){ next = t; }
+    uint32_t at() const { return target; }
+};
+
+template<typename Node>
+double walk(std::vector<Node>& nodes, std::mt19937& rng){
+    // link the nodes in a random order, like timers spread over the objects of an application
+    std::vector<size_t> order(nodes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    for (size_t i = 0; i + 1 < order.size(); ++i) nodes[order[i]].link(&nodes[order[i + 1]]);
+    nodes[order.back()].link(nullptr);
+
+    uint64_t sum = 0;
+    const int rounds = 5;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r){
+        for (Node* it = &nodes[order[0]]; it; it = it->link()) sum += it->at();
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sum == 1) puts(""); // keep the walk
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds / nodes.size();
+}
+
+int main(){
+    printf("TIMERARRAY_TICK_BITS=%u, host pointers of %zu bytes\n", timer_ticks_bits, sizeof(void*));
+    printf("%-22s %8s %8s\n", "", "legacy", "packed");
+    printf("%-22s %8zu %8zu\n", "Timer node", sizeof(LegacyTimer), sizeof(Timer));
+    printf("%-22s %8zu %8zu\n", "feed root", sizeof(LegacyTimer), sizeof(TimerLink));
+    printf("%-22s %8.2f %8.2f\n", "nodes per 64 B line", 64.0 / sizeof(LegacyTimer), 64.0 / sizeof(Timer));
+    for (size_t n : {100, 500}){
+        printf("%-22s %8zu %8zu\n", (std::to_string(n) + " timers, bytes").c_str(),
+            n * sizeof(LegacyTimer) + sizeof(LegacyTimer), n * sizeof(Timer) + sizeof(TimerLink));
+    }
+
+    std::mt19937 rng(1);
+    printf("\nwalk of a scattered feed, ns per node\n%-22s %8s %8s\n", "", "legacy", "packed");
+    for (size_t n : {1000, 10000, 100000, 1000000}){
+        std::vector<LegacyTimer> legacy(n);
+        std::vector<PackedTimer> packed(n);
+        double l = walk(legacy, rng);
+        double p = walk(packed, rng);
+        printf("%-22zu %8.2f %8.2f\n", n, l, p);
+    }
+    return 0;
+}
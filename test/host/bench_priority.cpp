@@ -0,0 +1,56 @@
+// Priority across batches: an urgent timer is due in the same tick as n logging timers,
+// more than a batch of TICK_BATCH_SIZE. Reports the rank the urgent timer fires at,
+// and the cost per firing with and without a prioritized timer attached.
+#include "sim.hpp"
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t fired = 0;
+uint32_t urgentRank = 0;
+void onLog(){ ++fired; }
+void onUrgent(){ urgentRank = ++fired; }
+
+struct Result{
+    uint32_t rank; // 1 is the first callback of the tick
+    double ns; // per firing
+};
+
+Result run(uint16_t logging, bool prioritized, int rounds){
+    SimTimer sim(32);
+    TimerArrayControl control(&sim.htim, 10000, 1, 32);
+    control.begin();
+
+    std::vector<Timer> logs;
+    logs.reserve(logging);
+    for (uint16_t i = 0; i < logging; ++i) logs.emplace_back(100, true, onLog);
+    Timer urgent(100, true, onUrgent);
+    if (prioritized) urgent.priority(9);
+
+    // a timer is inserted before the equal targets, the urgent one attached first is the last of them in the feed
+    control.attachTimer(&urgent);
+    for (Timer& log : logs) control.attachTimer(&log);
+    sim.run(99);
+
+    Result result;
+    auto start = Clock::now();
+    for (int i = 0; i < rounds; ++i){
+        fired = 0;
+        sim.run(100); // logging timers and the urgent one are due together every round
+        if (i == 0) result.rank = urgentRank;
+    }
+    result.ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((uint64_t)rounds * (logging + 1));
+    return result;
+}
+
+int main(){
+    printf("%8s %14s %14s %14s %14s\n", "logging", "rank", "rank prio", "ns/fire", "ns/fire prio");
+    for (uint16_t logging : {4, 12, 64, 256}){
+        Result plain = run(logging, false, 200);
+        Result prio = run(logging, true, 200);
+        CHECK(plain.rank == logging + 1u && prio.rank == 1);
+        printf("%8u %14u %14u %14.1f %14.1f\n", logging, plain.rank, prio.rank, plain.ns, prio.ns);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Simulated timer peripheral and a minimal check macro for the host tests.
+#pragma once
+
+#include "STM32TimerArray.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define CHECK(cond) do{ if (!(cond)){ printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); exit(1); } }while(0)
+
+// Counts like a general purpose timer of an STM32: the counter steps every PSC+1 input clocks,
+// a compare match on channel 1 or a CC1G software event pends the interrupt, which is served
+// synchronously while CC1 is enabled in DIER, latency counter steps after it was pended.
+// Channels 2-4 drive simulated pins by their output mode.
+// The prescaler is applied immediately, the update event of the hardware is not simulated.
+class SimTimer{
+public:
+    struct Edge{
+        uint64_t tick; // counter steps since the start of the simulation
+        uint8_t channel; // 2-4
+        bool level;
+    };
+
+    TIM_TypeDef regs;
+    TIM_HandleTypeDef htim;
+    std::vector<Edge> edges; // pin changes of channels 2-4
+    uint64_t ticks; // counter steps since the start
+    uint64_t clocks; // input clocks since the start
+    uint32_t interrupts; // served CC1 interrupts
+    uint32_t latency; // counter steps between pending and serving the interrupt
+
+    SimTimer(uint8_t bits=16) : regs(), htim(), ticks(0), clocks(0), interrupts(0), latency(0), pendedAt(0), divider(0),
+        mask(bits >= 32 ? 0xFFFFFFFFu : ((1u << bits) - 1)), pins{false, false, false, false}
+    {
+        htim.Instance = &regs;
+    }
+
+    // advance the counter by n steps
+    void run(uint64_t n){
+        for (uint64_t i = 0; i < n; ++i){
+            if (!(regs.CR1 & TIM_CR1_CEN)) return;
+            step();
+        }
+    }
+
+    // advance by n input clocks, the counter steps after every PSC+1 of them
+    void clock(uint64_t n){
+        for (uint64_t i = 0; i < n; ++i){
+            ++clocks;
+            if (!(regs.CR1 & TIM_CR1_CEN)) continue;
+            if (++divider > regs.PSC){
+                divider = 0;
+                step();
+            }
+        }
+    }
+
+    // capture the counter on channel 2-4 like an input edge
+    void capture(uint32_t channel){
+        __HAL_TIM_SET_COMPARE(&htim, channel, regs.CNT);
+        htim.Channel = (HAL_TIM_ActiveChannel)(1u << (channel >> 2));
+        HAL_TIM_IC_CaptureCallback(&htim);
+        htim.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+    }
+
+    bool pin(uint32_t channel) const{
+        return pins[channel >> 2];
+    }
+
+    // serve the pending interrupt, e.g. after it was enabled again
+    void service(){
+        while (true){
+            regs.EGR = regs.EGR & ~TIM_EGR_UG;
+            if (regs.EGR & TIM_EGR_CC1G){
+                regs.EGR = regs.EGR & ~TIM_EGR_CC1G;
+                pend();
+            }
+            if (!((regs.SR & TIM_FLAG_CC1) && (regs.DIER & TIM_IT_CC1))) break;
+            if (ticks - pendedAt < latency) break;
+
+            regs.SR = regs.SR & ~TIM_FLAG_CC1;
+            ++interrupts;
+            htim.Channel = HAL_TIM_ACTIVE_CHANNEL_1;
+            HAL_TIM_OC_DelayElapsedCallback(&htim);
+            htim.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+        }
+        outputs(false);
+    }
+
+private:
+    uint64_t pendedAt;
+    uint32_t divider;
+    const uint32_t mask;
+    bool pins[4];
+
+    void step(){
+        regs.CNT = (regs.CNT + 1) & mask;
+        ++ticks;
+        if (regs.CNT == regs.CCR1) pend();
+        outputs(true);
+        service();
+    }
+
+    void pend(){
+        if (!(regs.SR & TIM_FLAG_CC1)) pendedAt = ticks;
+        regs.SR = regs.SR | TIM_FLAG_CC1;
+    }
+
+    // drive the pins of the enabled output channels
+    void outputs(bool counted){
+        for (uint32_t channel = TIM_CHANNEL_2; channel <= TIM_CHANNEL_4; channel += 4){
+            if (!(regs.CCER & (1u << channel))) continue;
+
+            volatile uint32_t* ccmr = channel < TIM_CHANNEL_3 ? &regs.CCMR1 : &regs.CCMR2;
+            uint32_t shift = channel == TIM_CHANNEL_2 || channel == TIM_CHANNEL_4 ? 8 : 0;
+            uint32_t mode = (*ccmr >> shift) & 0x70;
+            bool match = counted && regs.CNT == __HAL_TIM_GET_COMPARE(&htim, channel);
+
+            bool level = pins[channel >> 2];
+            if (mode == TIM_OCMODE_FORCED_ACTIVE) level = true;
+            else if (mode == TIM_OCMODE_FORCED_INACTIVE) level = false;
+            else if (match && mode == TIM_OCMODE_ACTIVE) level = true;
+            else if (match && mode == TIM_OCMODE_INACTIVE) level = false;
+            else if (match && mode == TIM_OCMODE_TOGGLE) level = !level;
+
+            if (level != pins[channel >> 2]){
+                pins[channel >> 2] = level;
+                edges.push_back(Edge{ticks, (uint8_t)((channel >> 2) + 1), level});
+            }
+        }
+    }
+};
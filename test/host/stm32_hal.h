@@ -0,0 +1,91 @@
+// Stub of the STM32 HAL subset used by the library, for the host tests.
+// Registers are plain memory, the peripheral is simulated by SimTimer in sim.hpp.
+#pragma once
+
+#include <cstdint>
+
+#define F_CPU 72000000UL
+
+typedef struct {
+    volatile uint32_t CR1, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, CCR1, CCR2, CCR3, CCR4;
+} TIM_TypeDef;
+typedef struct { uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload; } TIM_Base_InitTypeDef;
+typedef struct { uint32_t OCMode, Pulse, OCPolarity, OCNPolarity, OCFastMode, OCIdleState, OCNIdleState; } TIM_OC_InitTypeDef;
+typedef struct { uint32_t ICPolarity, ICSelection, ICPrescaler, ICFilter; } TIM_IC_InitTypeDef;
+typedef enum {
+    HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0, HAL_TIM_ACTIVE_CHANNEL_1 = 1, HAL_TIM_ACTIVE_CHANNEL_2 = 2,
+    HAL_TIM_ACTIVE_CHANNEL_3 = 4, HAL_TIM_ACTIVE_CHANNEL_4 = 8
+} HAL_TIM_ActiveChannel;
+typedef struct { TIM_TypeDef* Instance; TIM_Base_InitTypeDef Init; HAL_TIM_ActiveChannel Channel; } TIM_HandleTypeDef;
+typedef int HAL_StatusTypeDef;
+
+#define TIM_CHANNEL_1 0x0U
+#define TIM_CHANNEL_2 0x4U
+#define TIM_CHANNEL_3 0x8U
+#define TIM_CHANNEL_4 0xCU
+#define TIM_IT_CC1 (1u << 1)
+#define TIM_FLAG_CC1 TIM_IT_CC1
+#define TIM_FLAG_UPDATE 1u
+#define TIM_CR1_CEN 1u
+#define TIM_EGR_UG 1u
+#define TIM_EGR_CC1G 2u
+#define TIM_COUNTERMODE_UP 0
+#define TIM_AUTORELOAD_PRELOAD_DISABLE 0
+#define TIM_CCMR1_OC1M 0x10070u
+#define TIM_OCMODE_TIMING 0x00u
+#define TIM_OCMODE_ACTIVE 0x10u
+#define TIM_OCMODE_INACTIVE 0x20u
+#define TIM_OCMODE_TOGGLE 0x30u
+#define TIM_OCMODE_FORCED_INACTIVE 0x40u
+#define TIM_OCMODE_FORCED_ACTIVE 0x50u
+#define TIM_OCPOLARITY_HIGH 0
+#define TIM_OCFAST_DISABLE 0
+#define TIM_ICPOLARITY_RISING 0
+#define TIM_ICPOLARITY_FALLING 2
+#define TIM_ICPOLARITY_BOTHEDGE 10
+#define TIM_ICSELECTION_DIRECTTI 1
+#define TIM_ICPSC_DIV1 0
+
+// register writes are statements, C++20 deprecates using the value of a volatile assignment
+inline void halWrite(volatile uint32_t& reg, uint32_t value){ reg = value; }
+
+#define __HAL_TIM_GET_COUNTER(h) ((h)->Instance->CNT)
+#define __HAL_TIM_SET_COUNTER(h, v) (halWrite((h)->Instance->CNT, (v)))
+#define __HAL_TIM_SET_COMPARE(h, ch, v) (halWrite(*(&(h)->Instance->CCR1 + ((ch) >> 2)), (v)))
+#define __HAL_TIM_GET_COMPARE(h, ch) (*(&(h)->Instance->CCR1 + ((ch) >> 2)))
+#define __HAL_TIM_ENABLE_IT(h, it) (halWrite((h)->Instance->DIER, (h)->Instance->DIER | (it)))
+#define __HAL_TIM_DISABLE_IT(h, it) (halWrite((h)->Instance->DIER, (h)->Instance->DIER & ~(it)))
+#define __HAL_TIM_SET_PRESCALER(h, v) (halWrite((h)->Instance->PSC, (v)))
+#define __HAL_TIM_SET_AUTORELOAD(h, v) (halWrite((h)->Instance->ARR, (v)))
+#define __HAL_TIM_ENABLE(h) (halWrite((h)->Instance->CR1, (h)->Instance->CR1 | TIM_CR1_CEN))
+#define __HAL_TIM_DISABLE(h) (halWrite((h)->Instance->CR1, (h)->Instance->CR1 & ~TIM_CR1_CEN))
+#define __HAL_TIM_CLEAR_FLAG(h, f) (halWrite((h)->Instance->SR, (h)->Instance->SR & ~(f))) // rc_w0 on the hardware, ones are ignored
+#define HAL_TIM_ReadCapturedValue(h, ch) __HAL_TIM_GET_COMPARE(h, ch)
+
+inline HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef* h){ h->Instance->ARR = h->Init.Period; h->Instance->PSC = h->Init.Prescaler; return 0; }
+inline HAL_StatusTypeDef HAL_TIM_OC_ConfigChannel(TIM_HandleTypeDef* h, TIM_OC_InitTypeDef* init, uint32_t ch){
+    __HAL_TIM_SET_COMPARE(h, ch, init->Pulse);
+    volatile uint32_t* ccmr = ch < TIM_CHANNEL_3 ? &h->Instance->CCMR1 : &h->Instance->CCMR2;
+    uint32_t shift = (ch == TIM_CHANNEL_2 || ch == TIM_CHANNEL_4) ? 8 : 0;
+    *ccmr = (*ccmr & ~(TIM_CCMR1_OC1M << shift)) | (init->OCMode << shift);
+    return 0;
+}
+inline HAL_StatusTypeDef HAL_TIM_OC_Start_IT(TIM_HandleTypeDef* h, uint32_t){ h->Instance->CR1 = h->Instance->CR1 | TIM_CR1_CEN; h->Instance->DIER = h->Instance->DIER | TIM_IT_CC1; return 0; }
+inline HAL_StatusTypeDef HAL_TIM_OC_Stop_IT(TIM_HandleTypeDef* h, uint32_t){ h->Instance->CR1 = h->Instance->CR1 & ~TIM_CR1_CEN; h->Instance->DIER = h->Instance->DIER & ~TIM_IT_CC1; return 0; }
+inline HAL_StatusTypeDef HAL_TIM_OC_Start(TIM_HandleTypeDef* h, uint32_t ch){ h->Instance->CCER = h->Instance->CCER | 1u << ch; return 0; }
+inline HAL_StatusTypeDef HAL_TIM_OC_Stop(TIM_HandleTypeDef* h, uint32_t ch){ h->Instance->CCER = h->Instance->CCER & ~(1u << ch); return 0; }
+inline HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef*){ return 0; }
+inline HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef*, TIM_IC_InitTypeDef*, uint32_t){ return 0; }
+inline HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* h, uint32_t ch){ h->Instance->CCER = h->Instance->CCER | 1u << ch; return 0; }
+inline HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef* h, uint32_t ch){ h->Instance->CCER = h->Instance->CCER & ~(1u << ch); return 0; }
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim);
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim);
+
+// core intrinsics, the host runs the interrupts synchronously from the simulation
+inline uint32_t __get_PRIMASK(){ return 0; }
+inline void __set_PRIMASK(uint32_t){}
+inline void __disable_irq(){}
+inline void __enable_irq(){}
+inline void __WFI(){}
+inline void __DMB(){ __asm__ volatile("" ::: "memory"); }
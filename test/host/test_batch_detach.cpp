@@ -0,0 +1,48 @@
+// Timers due in the same tick are collected before their callbacks run,
+// a callback detaching or cancelling a later one of the batch still stops it.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+StaticTimerPool<4> pool;
+
+int order[8];
+int fired = 0;
+TimerHandle pooled;
+
+struct Slot{ int id; };
+Slot ids[5] = {{0}, {1}, {2}, {3}, {4}};
+ContextTimer<Slot>* timers[5];
+
+void onTimer(Slot* slot){
+    order[fired++] = slot->id;
+    if (slot->id == 0){
+        // the response handler stops its timeout, which is due in the same tick
+        control.detachTimer(timers[1]);
+        control.cancelTimer(timers[2]);
+        control.restartTimer(timers[3]); // fires after its full delay instead
+        CHECK(pooled.cancel());
+    }
+}
+
+void onPooled(void*){ order[fired++] = 99; }
+
+int main(){
+    control.setTimerPool(&pool);
+    control.begin();
+    for (int i = 4; i >= 0; --i){
+        // equal targets fire in reverse order of attaching
+        timers[i] = new ContextTimer<Slot>(100, false, &ids[i], onTimer);
+    }
+    pooled = control.after(100, onPooled);
+    for (int i = 4; i >= 0; --i) control.attachTimer(timers[i]);
+
+    sim.run(100);
+    CHECK(fired == 2 && order[0] == 0 && order[1] == 4);
+    CHECK(!timers[1]->isRunning() && !timers[2]->isRunning() && timers[3]->isRunning());
+    CHECK(!pooled.isPending() && pool.available() == 4);
+
+    sim.run(100);
+    CHECK(fired == 3 && order[2] == 3);
+    puts("ok");
+}
@@ -0,0 +1,52 @@
+// The controller's own calls on the members of a TimerBlock are ignored, the members stay in the block
+// and no tombstone is left in the feed. A member that left the block is an ordinary timer again.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+StaticTimerBlock<4> block(&control);
+
+uint32_t fired = 0;
+void onFire(){ ++fired; }
+Timer first(100, false, onFire), second(200, false, onFire), periodic(50, true, onFire);
+
+int main(){
+    control.begin();
+    CHECK(block.attachTimer(&first) && block.attachTimer(&second) && block.attachTimer(&periodic));
+    CHECK(block.size() == 3 && control.attachedTimers() == 1);
+
+    control.cancelTimer(&first);
+    control.detachTimer(&second);
+    control.changeTimerDelay(&periodic, 10);
+    control.restartTimer(&periodic);
+    control.manualFire(&periodic);
+    CHECK(fired == 0 && block.size() == 3 && control.attachedTimers() == 1);
+    CHECK(first.isRunning() && second.isRunning() && periodic.isRunning());
+
+    // the members fire from the block as attached
+    sim.run(201);
+    CHECK(fired == 2 + 4);
+    CHECK(!first.isRunning() && !second.isRunning() && block.size() == 1);
+
+    // out of the block, the controller handles it again
+    block.detachTimer(&periodic);
+    control.attachTimer(&periodic);
+    CHECK(control.attachedTimers() == 1); // the empty block left the feed
+    control.cancelTimer(&periodic);
+    CHECK(!periodic.isRunning());
+
+    // the tombstone is unlinked before the block takes the timer, it would release the member when collected
+    CHECK(block.attachTimer(&periodic));
+    sim.run(101);
+    CHECK(fired == 6 + 2 && periodic.isRunning() && block.size() == 1 && control.attachedTimers() == 1);
+    block.detachTimer(&periodic);
+
+    // a timer running on the feed is not taken
+    control.attachTimer(&first);
+    CHECK(!block.attachTimer(&first) && block.size() == 0);
+    sim.run(101);
+    CHECK(fired == 9);
+
+    puts("ok");
+    return 0;
+}
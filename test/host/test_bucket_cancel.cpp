@@ -0,0 +1,42 @@
+// A cancelled timer of a period bucket stays linked there, changing its delay meanwhile
+// must not leave it linked twice when it is attached again.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+TimerBucket buckets[2];
+
+uint32_t fired = 0;
+void onTimer(){ ++fired; }
+
+Timer p1(100, true, onTimer), p2(100, true, onTimer), p3(100, true, onTimer);
+
+int main(){
+    control.usePeriodBuckets(buckets, 2);
+    control.begin();
+    control.attachTimer(&p1);
+    control.attachTimer(&p2);
+    control.attachTimer(&p3);
+
+    // the setter changes the delay of the tombstone behind the controller's back
+    control.cancelTimer(&p2);
+    p2.delay(150);
+    control.attachTimer(&p2);
+    CHECK(p2.isRunning() && control.attachedTimers() == 3);
+
+    // the delay change of the controller unlinks the tombstone first
+    control.cancelTimer(&p3);
+    control.changeTimerDelay(&p3, 80);
+    control.attachTimer(&p3);
+    CHECK(p3.isRunning() && control.attachedTimers() == 3);
+
+    sim.run(1200);
+    // p1 every 100, p2 every 150, p3 every 80
+    CHECK(fired == 12 + 8 + 15);
+
+    control.detachTimer(&p1);
+    control.detachTimer(&p2);
+    control.detachTimer(&p3);
+    CHECK(control.attachedTimers() == 0 && buckets[0].isEmpty() && buckets[1].isEmpty());
+    puts("ok");
+}
@@ -0,0 +1,55 @@
+// Lazy cancel: a cancelled timer stays linked in its controller until it is unlinked,
+// it must not be attached to another controller meanwhile.
+#include "sim.hpp"
+
+SimTimer simA, simB;
+TimerArrayControl a(&simA.htim, 10000, 1, 16);
+TimerArrayControl b(&simB.htim, 10000, 1, 16);
+
+uint32_t firedA = 0, firedB = 0;
+void onA(){ ++firedA; }
+void onB(){ ++firedB; }
+
+Timer first(100, false, onA), last(300, false, onA);
+
+int main(){
+    a.begin();
+    b.begin();
+
+    Timer moving(200, false, onB);
+    a.attachTimer(&first);
+    a.attachTimer(&moving);
+    a.attachTimer(&last);
+    a.cancelTimer(&moving);
+    CHECK(!moving.isRunning() && a.attachedTimers() == 2);
+
+    // the tombstone is still linked in a, b refuses it
+    b.attachTimer(&moving);
+    CHECK(!moving.isRunning() && b.attachedTimers() == 0);
+
+    // attaching it to a again unlinks the tombstone first
+    a.attachTimer(&moving);
+    CHECK(moving.isRunning() && a.attachedTimers() == 3);
+    a.cancelTimer(&moving);
+
+    // detach unlinks the tombstone at once, then it can go anywhere
+    a.detachTimer(&moving);
+    b.attachTimer(&moving);
+    CHECK(moving.isRunning() && b.attachedTimers() == 1);
+
+    simA.run(400);
+    simB.run(400);
+    CHECK(firedA == 2 && firedB == 1);
+
+    // a stack timer cancelled then detached leaves nothing behind when destroyed
+    {
+        Timer scoped(50, false, onA);
+        a.attachTimer(&scoped);
+        a.attachTimer(&first);
+        a.cancelTimer(&scoped);
+        a.detachTimer(&scoped);
+    }
+    simA.run(200);
+    CHECK(firedA == 3 && a.attachedTimers() == 0);
+    puts("ok");
+}
@@ -0,0 +1,49 @@
+// An edge captured by a TimerCapture is in the controller's time, a timer attached at an offset from it
+// fires that many ticks after the edge, also after shiftAll moved the controller's time.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+StaticTimerCapture<4> capture;
+
+uint32_t firedAt = 0, firedCnt = 0;
+void onFire(){
+    firedAt = control.counter();
+    firedCnt = sim.regs.CNT;
+}
+Timer timer(0, false, onFire);
+
+// captures an edge now and fires the timer offset ticks after it
+void fireAfterEdge(uint32_t offset){
+    const uint32_t edgeCnt = sim.regs.CNT;
+    sim.capture(TIM_CHANNEL_2);
+
+    uint32_t edge;
+    CHECK(capture.available() == 1 && capture.read(edge) && capture.available() == 0);
+    CHECK(edge == control.counter()); // no tick passed since the edge
+
+    // the reader is late, the offset is still counted from the edge
+    sim.run(40);
+    control.attachAt(&timer, edge + offset);
+    sim.run(offset);
+    CHECK(firedAt == ((edge + offset) & control.maxCount()));
+    CHECK(firedCnt == ((edgeCnt + offset) & control.maxCount()));
+}
+
+int main(){
+    control.begin();
+    control.attachCapture(&capture, TIM_CHANNEL_2);
+    sim.run(123);
+
+    fireAfterEdge(300);
+
+    // the controller's time moves away from the hardware counter, the captures follow it
+    control.shiftAll(500);
+    sim.run(77);
+    CHECK(control.counter() != sim.regs.CNT);
+    fireAfterEdge(300);
+
+    CHECK(capture.overruns() == 0);
+    puts("ok");
+    return 0;
+}
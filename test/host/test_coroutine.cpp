@@ -0,0 +1,48 @@
+// Coroutines waiting on timers, resumed inline and by an executor, with their frames in a fixed arena.
+// Built with -std=gnu++20, the other tests are C++17.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+StaticCoroutineArena<256, 2> arena;
+TimerExecutor executor;
+
+uint32_t steps = 0;
+uint32_t resumedAt[3];
+
+TimerTask count(CoroutineArena&, uint32_t n, TimerExecutor* executor){
+    for (uint32_t i = 0; i < n; ++i){
+        co_await control.delay(100, executor);
+        resumedAt[steps++] = sim.regs.CNT;
+    }
+}
+
+int main(){
+    control.begin();
+    const uint32_t start = sim.regs.CNT;
+
+    // resumed inside the timer interrupt
+    TimerTask inlineTask = count(arena, 2, nullptr);
+    CHECK(inlineTask.isValid() && arena.available() == 1);
+    sim.run(201);
+    CHECK(steps == 2 && resumedAt[0] == start + 100 && resumedAt[1] == start + 200);
+    CHECK(arena.available() == 2); // the finished frame is back in the arena
+
+    // queued by the interrupt, resumed from the main loop
+    TimerTask queuedTask = count(arena, 1, &executor);
+    CHECK(queuedTask.isValid());
+    sim.run(150);
+    CHECK(steps == 2 && executor.hasPending());
+    CHECK(executor.runPending() && steps == 3 && !executor.runPending());
+    CHECK(arena.available() == 2);
+
+    // no free block, the task is invalid and nothing runs
+    steps = 0;
+    TimerTask first = count(arena, 1, nullptr), second = count(arena, 1, nullptr), third = count(arena, 1, nullptr);
+    CHECK(first.isValid() && second.isValid() && !third.isValid());
+    sim.run(101);
+    CHECK(steps == 2 && arena.available() == 2);
+
+    puts("ok");
+    return 0;
+}
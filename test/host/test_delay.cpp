@@ -0,0 +1,35 @@
+// Delays longer than the stored counter values saturate at timer_ticks_max, also built with TIMERARRAY_TICK_BITS=16.
+#include "sim.hpp"
+
+SimTimer sim(timer_ticks_bits);
+TimerArrayControl control(&sim.htim, 10000, 1, 32);
+
+uint32_t fired = 0;
+void onFire(){ ++fired; }
+
+int main(){
+    control.begin();
+    const uint32_t longDelay = 70000;
+    const uint32_t stored = timer_ticks_bits == 16 ? 65535 : longDelay;
+
+    Timer timer(longDelay, false, onFire);
+    CHECK(timer.delay() == stored);
+    timer.delay(longDelay + 1);
+    CHECK(timer.delay() == (timer_ticks_bits == 16 ? 65535 : longDelay + 1));
+    CHECK(control.maxCount() == timer_ticks_max);
+
+    // a running timer saturates on the change of its delay as well
+    timer.delay(100);
+    control.attachTimer(&timer);
+    control.changeTimerDelay(&timer, longDelay);
+    CHECK(timer.delay() == stored);
+
+    // the saturated delay fires after timer_ticks_max ticks at most, never early due to wrapping
+    sim.run(stored - 2);
+    CHECK(fired == 0);
+    sim.run(3);
+    CHECK(fired == 1);
+
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,42 @@
+// The timing of a callback is read when it is dispatched, a slow callback earlier in the batch
+// makes the later ones of the same tick late, also in a TimerBlock.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+StaticTimerBlock<2> block(&control);
+
+const uint32_t busy = 50; // ticks the slow callback takes
+TimerFireInfo infos[4];
+int fired = 0;
+
+void onTimer(const TimerFireInfo& info){
+    infos[fired++] = info;
+    if (fired % 2) sim.regs.CNT = (sim.regs.CNT + busy) & control.maxCount(); // the counter runs on in the callback
+}
+
+TimingTimer slow(100, false, onTimer), late(100, false, onTimer);
+TimingTimer slowMember(100, false, onTimer), lateMember(100, false, onTimer);
+
+int main(){
+    control.begin();
+
+    // equal targets fire in reverse order of attaching
+    control.attachTimer(&late);
+    control.attachTimer(&slow);
+    sim.run(100);
+    CHECK(fired == 2);
+    CHECK(infos[0].scheduled == infos[1].scheduled && infos[0].lateness == 0);
+    CHECK(infos[1].now == infos[0].now + busy && infos[1].lateness == busy);
+
+    // the block fires equal targets in attach order
+    block.attachTimer(&slowMember);
+    block.attachTimer(&lateMember);
+    sim.run(100);
+    CHECK(fired == 4);
+    CHECK(infos[2].scheduled == infos[3].scheduled && infos[2].lateness == 0);
+    CHECK(infos[3].now == infos[2].now + busy && infos[3].lateness == busy);
+
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Low-power waiting with the idle hook: the simulated core sleeps until the next timer,
+// the test counts the wake-ups and the ticks spent asleep.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+
+const uint32_t latency = 5; // ticks the core needs to wake up
+uint32_t wakeups = 0;
+uint64_t asleep = 0;
+uint32_t sleepTicks = 0;
+uint32_t fired = 0;
+uint32_t worstLateness = 0;
+
+void onTimer(const TimerFireInfo& info){
+    ++fired;
+    if (info.lateness > worstLateness) worstLateness = info.lateness;
+}
+
+TimingTimer fast(1000, true, onTimer);
+TimingTimer slow(1500, true, onTimer);
+TimingTimer once(7250, false, onTimer);
+
+void enterStop(uint32_t ticks, void*){
+    ++wakeups;
+    sleepTicks = ticks;
+}
+
+int main(){
+    control.begin();
+
+    uint32_t deadline;
+    CHECK(!control.nextDeadline(deadline));
+    CHECK(control.ticksUntilNext() == control.maxCount());
+    CHECK(!control.idle()); // no hook yet
+
+    control.attachTimer(&fast);
+    control.attachTimer(&slow);
+    control.attachTimer(&once);
+    CHECK(control.nextDeadline(deadline) && deadline == 1000);
+    CHECK(control.ticksUntilNext() == 1000);
+
+    control.setIdleHook(enterStop, nullptr, latency);
+
+    // main loop of 30000 ticks, sleeping whenever possible
+    const uint64_t total = 30000;
+    while (sim.ticks < total){
+        if (control.idle()){
+            // the wake-up source fires after the requested ticks, the core runs again latency ticks later
+            asleep += sleepTicks;
+            sim.run(sleepTicks + latency);
+        } else {
+            sim.run(1);
+        }
+    }
+
+    // expiries at the multiples of 1000 and 1500, plus the one-shot timer
+    const uint32_t expiries = 30 + 20 + 1;
+    const uint32_t instants = 30 + 20 - 10 + 1;
+    printf("fired %u, wakeups %u, idle residency %.1f%%, worst lateness %u\n",
+        fired, wakeups, 100.0 * asleep / total, worstLateness);
+
+    CHECK(fired == expiries);
+    CHECK(worstLateness == 0); // the sleep ends before the deadlines
+    CHECK(wakeups <= instants + 1); // a single wake-up per distinct deadline
+    CHECK(asleep * 100 >= total * 95);
+
+    // the cancelled head is not reported, the sleep goes to the next running timer
+    control.cancelTimer(&fast);
+    control.cancelTimer(&slow);
+    CHECK(!control.nextDeadline(deadline));
+    puts("ok");
+}
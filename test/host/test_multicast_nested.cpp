@@ -0,0 +1,41 @@
+// Nested firings of a MulticastTimer: a subscriber fires the timer again, and unsubscribes the next
+// subscriber inside the nested firing. Both walks skip it and continue on their own.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+MulticastTimer multicast(100, false);
+
+uint32_t calls[3] = {};
+bool nested = false;
+void onFirst();
+void onSecond(){ ++calls[1]; }
+void onThird(){ ++calls[2]; }
+TimerSubscriber first(onFirst), second(onSecond), third(onThird);
+
+void onFirst(){
+    ++calls[0];
+    if (nested){
+        // both the nested and the outer walk are about to call second
+        multicast.unsubscribe(&second);
+        return;
+    }
+    nested = true;
+    control.manualFire(&multicast);
+}
+
+int main(){
+    control.begin();
+
+    // called in reverse order of subscribing
+    multicast.subscribe(&third);
+    multicast.subscribe(&second);
+    multicast.subscribe(&first);
+    control.attachTimer(&multicast);
+    sim.run(101);
+
+    CHECK(calls[0] == 2 && calls[1] == 0 && calls[2] == 2);
+    CHECK(multicast.subscribers() == 2 && !second.isSubscribed());
+    puts("ok");
+    return 0;
+}
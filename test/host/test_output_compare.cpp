@@ -0,0 +1,80 @@
+// Pin timing of OutputCompareTimer on the simulated peripheral: the edges are made by the
+// compare match, so they stay exact while the interrupt is served late.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+
+uint32_t calls = 0;
+void onEdge(){ ++calls; }
+
+OutputCompareTimer square(100, true, TIM_CHANNEL_2, OutputCompareTimer::TOGGLE, 20);
+OutputCompareTimer pulse(250, false, TIM_CHANNEL_3, OutputCompareTimer::SET, 20, onEdge);
+OutputCompareTimer plain(50, false, TIM_CHANNEL_4, OutputCompareTimer::SET, 5, onEdge);
+
+int main(){
+    sim.latency = 15; // shorter than the lead
+    control.begin();
+
+    // channel 1 drives the controller
+    OutputCompareTimer wrong(10, true, TIM_CHANNEL_1, OutputCompareTimer::SET);
+    control.attachOutputTimer(&wrong);
+    CHECK(!wrong.isRunning());
+
+    // attached as an ordinary timer: the callback runs, no edge, no crash
+    control.attachTimer(&plain);
+
+    control.attachOutputTimer(&square);
+    control.attachOutputTimer(&pulse);
+    CHECK(!sim.pin(TIM_CHANNEL_2) && !sim.pin(TIM_CHANNEL_3));
+
+    sim.run(1000);
+
+    // the toggles come lead ticks after every firing, to the tick
+    uint32_t toggles = 0;
+    for (const SimTimer::Edge& e : sim.edges){
+        if (e.channel == 2){
+            ++toggles;
+            CHECK(e.tick == 100 * toggles + 20);
+            CHECK(e.level == (toggles % 2 == 1));
+        }
+        CHECK(e.channel != 4);
+    }
+    CHECK(toggles == 9);
+
+    // a single set edge at 270
+    uint32_t sets = 0;
+    for (const SimTimer::Edge& e : sim.edges){
+        if (e.channel == 3){
+            ++sets;
+            CHECK(e.tick == 270 && e.level);
+        }
+    }
+    CHECK(sets == 1 && pulse.level() && !pulse.isRunning());
+    CHECK(calls == 2);
+
+    // an edge that passed before it was programmed is forced immediately
+    control.detachTimer(&square);
+    sim.edges.clear();
+    sim.latency = 30; // longer than the lead
+    control.attachTimer(&square);
+    const uint64_t start = sim.ticks;
+    sim.run(300);
+    CHECK(sim.edges.size() == 2);
+    CHECK(sim.edges[0].tick == start + 100 + 30);
+    CHECK(sim.edges[1].tick == start + 200 + 30);
+
+    // shiftAll postpones the programmed edge with the timers
+    control.detachTimer(&square);
+    sim.edges.clear();
+    sim.latency = 0;
+    control.attachTimer(&square);
+    const uint64_t shifted = sim.ticks;
+    sim.run(110);
+    control.shiftAll(50);
+    sim.run(190);
+    CHECK(sim.edges.size() == 2);
+    CHECK(sim.edges[0].tick == shifted + 120 + 50);
+    CHECK(sim.edges[1].tick == shifted + 220 + 50);
+    puts("ok");
+}
@@ -0,0 +1,39 @@
+// restartTimer on a timer placed further than its delay, by attachAt or a timer table offset:
+// the new deadline comes before the current target, the timer is moved at once.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+
+uint64_t firedAt = 0, tableFiredAt = 0, laterFiredAt = 0;
+void onFire(){ firedAt = sim.ticks; }
+void onTable(){ tableFiredAt = sim.ticks; }
+void onLater(){ laterFiredAt = sim.ticks; }
+
+Timer placed(100, false, onFire), table(100, false, onTable), later(100, false, onLater);
+
+int main(){
+    control.begin();
+    const uint64_t start = sim.ticks;
+    control.attachAt(&placed, control.counter() + 5000);
+    const TimerTableEntry entries[] = {{&table, 5000}};
+    control.attachTimerTable(entries, 1);
+    control.attachTimer(&later);
+
+    sim.run(10);
+    control.restartTimer(&placed);
+    control.restartTimer(&table);
+    CHECK(control.remainingTicks(&placed) == 100 && control.elapsedTicks(&placed) == 0);
+
+    // the lazy path is kept for a deadline after the target
+    sim.run(40);
+    control.restartTimer(&later);
+    CHECK(control.remainingTicks(&later) == 100);
+
+    sim.run(200);
+    CHECK(firedAt == start + 110 && tableFiredAt == start + 110);
+    CHECK(laterFiredAt == start + 150);
+    CHECK(control.attachedTimers() == 0);
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Deadline error across a retune: the input clock of the timer is halved in the middle of the delays,
+// the timers and the programmed edge keep their time, to a tick of the new frequency.
+// The time is counted in input clocks of the original 2 MHz clock.
+#include "sim.hpp"
+
+#include <cstdlib>
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 2000000, 200, 16); // 10 kHz ticks, 200 clocks each
+
+const uint64_t full_clock = 2000000;
+uint64_t now = 0;
+uint64_t inputClock = full_clock; // current input clock
+uint64_t phase = 0;
+std::vector<uint64_t> edges; // time of the pin edges
+
+void advance(uint64_t units){
+    for (uint64_t i = 0; i < units; ++i){
+        ++now;
+        phase += inputClock;
+        if (phase < full_clock) continue;
+        phase -= full_clock;
+        const size_t before = sim.edges.size();
+        sim.clock(1);
+        if (sim.edges.size() != before) edges.push_back(now);
+    }
+}
+
+std::vector<uint64_t> fired;
+uint64_t oneShotAt = 0;
+void onPeriodic(){ fired.push_back(now); }
+void onOneShot(){ oneShotAt = now; }
+
+Timer periodic(300, true, onPeriodic); // 60000 units
+Timer oneShot(1000, false, onOneShot); // 200000 units
+OutputCompareTimer square(300, true, TIM_CHANNEL_2, OutputCompareTimer::TOGGLE, 50); // edges 10000 units after the firings
+
+uint64_t worst = 0;
+void expect(uint64_t at, uint64_t deadline){
+    const uint64_t error = at > deadline ? at - deadline : deadline - at;
+    if (error > worst) worst = error;
+    CHECK(error <= 400); // a tick at the new frequency
+}
+
+int main(){
+    control.begin();
+    control.attachTimer(&periodic);
+    control.attachTimer(&oneShot);
+    control.attachOutputTimer(&square);
+
+    // the edge of the second square firing is pending at 130000
+    advance(125000);
+    CHECK(fired.size() == 2 && edges.size() == 1);
+
+    inputClock = full_clock / 2;
+    control.retune(1000000, 200);
+    CHECK(control.fclk() == 1000000 && control.clkdiv() == 200 && control.prescaler() == 200);
+    CHECK(periodic.delay() == 150 && oneShot.delay() == 500);
+
+    advance(185000);
+    CHECK(fired.size() == 5);
+    for (size_t i = 0; i < fired.size(); ++i) expect(fired[i], 60000 * (i + 1));
+    CHECK(oneShotAt != 0);
+    expect(oneShotAt, 200000);
+
+    // the lead stays 50 ticks, it is 20000 units after the retune
+    CHECK(edges.size() == 4);
+    expect(edges[0], 70000);
+    expect(edges[1], 130000);
+    expect(edges[2], 180000 + 20000);
+    expect(edges[3], 240000 + 20000);
+    printf("worst deadline error %llu of 400\n", (unsigned long long)worst);
+    puts("ok");
+    return 0;
+}
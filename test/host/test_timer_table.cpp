@@ -0,0 +1,32 @@
+// Attaching a timer table unlinks the cancelled timers at the front of the feed on its way,
+// the compare value has to follow the new first timer.
+#include "sim.hpp"
+
+SimTimer sim;
+TimerArrayControl control(&sim.htim, 10000, 1, 16);
+
+uint32_t fired = 0;
+void onFire(){ ++fired; }
+
+Timer early(100, false, onFire), late(200, false, onFire), table(300, false, onFire);
+
+int main(){
+    control.begin();
+    control.attachTimer(&early);
+    control.attachTimer(&late);
+    control.cancelTimer(&early);
+
+    const TimerTableEntry entries[] = {{&table, 300}};
+    control.attachTimerTable(entries, 1);
+    CHECK(control.attachedTimers() == 2);
+
+    // the compare value no longer waits for the removed timer
+    sim.run(199);
+    CHECK(fired == 0);
+    sim.run(2);
+    CHECK(fired == 1 && !late.isRunning());
+    sim.run(100);
+    CHECK(fired == 2 && !table.isRunning() && !early.isRunning());
+    puts("ok");
+    return 0;
+}
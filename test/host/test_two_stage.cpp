@@ -0,0 +1,83 @@
+// Handover between the stages of a TwoStageTimer while the interrupt of one controller preempts the tick of the other.
+// One coarse tick is 100 fine ticks, the ticks of one controller are stepped inside a callback of the other one.
+#include "sim.hpp"
+#include "TwoStageTimer.hpp"
+
+SimTimer simCoarse, simFine;
+TimerArrayControl coarse(&simCoarse.htim, 10000, 100, 16);
+TimerArrayControl fine(&simFine.htim, 10000, 1, 16);
+TwoStageControl twoStage(&coarse, &fine);
+
+uint64_t now = 0; // fine ticks
+bool coarseInsideFine = true; // which controller's callbacks step the other one
+
+void syncCoarse(){
+    while (simCoarse.ticks < now / 100) simCoarse.run(1);
+}
+
+void syncFine(){
+    while (now < simCoarse.ticks * 100){
+        ++now;
+        simFine.run(1);
+    }
+}
+
+void busyFine(){ if (coarseInsideFine) syncCoarse(); }
+void busyCoarse(){ if (!coarseInsideFine) syncFine(); }
+Timer fineBusy(300, true, busyFine), coarseBusy(1, true, busyCoarse);
+
+void run(uint64_t ticks){
+    const uint64_t end = now + ticks;
+    while (now < end){
+        if (coarseInsideFine){
+            ++now;
+            simFine.run(1);
+            syncCoarse();
+        } else {
+            simCoarse.run(1);
+            syncFine();
+        }
+    }
+}
+
+uint64_t fired[8];
+int count = 0;
+void onFire(){ if (count < 8) fired[count] = now; ++count; }
+
+int main(){
+    coarse.begin();
+    fine.begin();
+    run(1000);
+    fine.attachTimer(&fineBusy);
+    coarse.attachTimer(&coarseBusy);
+
+    // the coarse stage fires inside a fine tick for one of three starting phases, the handover is postponed
+    for (int phase = 0; phase < 3; ++phase){
+        TwoStageTimer timer(1000000, false, onFire);
+        count = 0;
+        const uint64_t start = now;
+        twoStage.attachTimer(&timer);
+        run(1000100);
+        CHECK(count == 1 && fired[0] - start == 1000000);
+        CHECK(!timer.isRunning());
+        run(200); // the next start is a coarse tick later in the period of fineBusy
+    }
+
+    // every fine tick is inside a coarse tick now, the fine stage bridges the coarse tick instead of attaching the coarse stage
+    coarseInsideFine = false;
+    run(100);
+    TwoStageTimer periodic(250000, true, onFire);
+    count = 0;
+    const uint64_t start = now;
+    twoStage.attachTimer(&periodic);
+    run(1000100);
+    CHECK(count == 4);
+    for (int i = 0; i < 4; ++i) CHECK(fired[i] - start == (uint64_t)(i + 1) * 250000);
+
+    twoStage.detachTimer(&periodic);
+    run(300000);
+    CHECK(count == 4);
+
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Decode a TimerArrayControl trace dump into Chrome/Perfetto trace JSON.
+
+The dump is the byte stream written by TimerArrayControl::dumpTrace
+(a TimerTraceHeader followed by TimerTraceEvent records, little endian).
+Open the JSON output in chrome://tracing or https://ui.perfetto.dev.
+Summary statistics are printed to stderr.
+
+usage: trace2chrome.py dump.bin [-o trace.json] [--frequency HZ]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<IHBBII")
+EVENT = struct.Struct("<III")
+MAGIC = 0x52544154
+VERSION = 1
+
+EVENT_NAMES = {
+    1: "attach",
+    2: "detach",
+    3: "cancel",
+    4: "restart",
+    5: "delay change",
+    6: "fire",
+    7: "late fire",
+    8: "manual fire",
+    9: "ccr write",
+    10: "shift",
+}
+CCR_WRITE = 9
+FIRES = (6, 7)
+
+
+def read_dump(data):
+    if len(data) < HEADER.size:
+        raise ValueError("dump is shorter than the header")
+    magic, version, bits, _, frequency, count = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError("bad magic 0x%08x, not a TimerArrayControl trace" % magic)
+    if version != VERSION:
+        raise ValueError("unsupported trace version %d" % version)
+    available = (len(data) - HEADER.size) // EVENT.size
+    if available < count:
+        print("warning: dump truncated, %d of %d events present" % (available, count), file=sys.stderr)
+        count = available
+    events = [EVENT.unpack_from(data, HEADER.size + i * EVENT.size) for i in range(count)]
+    return bits, frequency, events
+
+
+def unwrap(events, bits):
+    """Turn wrapping counter values into monotonic ticks, assuming less than one wrap between events."""
+    mask = (1 << bits) - 1
+    ticks = []
+    total = 0
+    previous = None
+    for timestamp, _, _ in events:
+        timestamp &= mask
+        if previous is not None:
+            total += (timestamp - previous) & mask
+        previous = timestamp
+        ticks.append(total)
+    return ticks
+
+
+def convert(events, ticks, frequency):
+    us_per_tick = 1e6 / frequency
+    trace = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "TimerArrayControl"}}]
+    named = set()
+    for (timestamp, ref, info), tick in zip(events, ticks):
+        kind = info & 0xFF
+        arg = info >> 8
+        ts = tick * us_per_tick
+        if kind == CCR_WRITE:
+            trace.append({"name": "CCR", "ph": "C", "pid": 1, "ts": ts, "args": {"value": ref}})
+            continue
+        if ref not in named:
+            named.add(ref)
+            trace.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": ref,
+                          "args": {"name": "timer 0x%08x" % ref}})
+        name = EVENT_NAMES.get(kind, "event %d" % kind)
+        args = {"counter": timestamp}
+        if kind in FIRES:
+            args["lateness_ticks"] = arg
+        elif arg:
+            args["ticks"] = arg
+        trace.append({"name": name, "ph": "i", "s": "t", "pid": 1, "tid": ref, "ts": ts, "args": args})
+    return trace
+
+
+def summarize(events, ticks, frequency, out):
+    counts = {}
+    timers = {}
+    for (_, ref, info), tick in zip(events, ticks):
+        kind = info & 0xFF
+        counts[kind] = counts.get(kind, 0) + 1
+        if kind in FIRES:
+            stats = timers.setdefault(ref, {"fires": 0, "late": 0, "lateness": [], "fire_ticks": []})
+            stats["fires"] += 1
+            stats["late"] += kind == 7
+            stats["lateness"].append(info >> 8)
+            stats["fire_ticks"].append(tick)
+
+    span = ticks[-1] - ticks[0] if ticks else 0
+    print("%d events over %d ticks (%.3f ms at %d Hz)" % (len(events), span, span * 1e3 / frequency, frequency), file=out)
+    for kind in sorted(counts):
+        print("  %-13s %d" % (EVENT_NAMES.get(kind, "event %d" % kind), counts[kind]), file=out)
+
+    if timers:
+        print("%-12s %7s %6s %10s %10s %12s" % ("timer", "fires", "late", "avg late", "max late", "avg period"), file=out)
+    for ref in sorted(timers):
+        stats = timers[ref]
+        lateness = stats["lateness"]
+        fire_ticks = stats["fire_ticks"]
+        periods = [b - a for a, b in zip(fire_ticks, fire_ticks[1:])]
+        period = "%.1f" % (sum(periods) / len(periods)) if periods else "-"
+        print("0x%08x %7d %6d %10.2f %10d %12s" % (ref, stats["fires"], stats["late"],
+              sum(lateness) / len(lateness), max(lateness), period), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="binary dump written by TimerArrayControl::dumpTrace")
+    parser.add_argument("-o", "--output", help="JSON output file, stdout if omitted")
+    parser.add_argument("--frequency", type=float, help="override the tick frequency of the dump (Hz)")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        bits, frequency, events = read_dump(f.read())
+    if args.frequency:
+        frequency = args.frequency
+    if not frequency:
+        parser.error("the dump has no tick frequency, use --frequency")
+
+    ticks = unwrap(events, bits)
+    trace = {"traceEvents": convert(events, ticks, frequency), "displayTimeUnit": "ns"}
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+        sys.stdout.write("\n")
+
+    summarize(events, ticks, frequency, sys.stderr)
+
+
+if __name__ == "__main__":
+    main()